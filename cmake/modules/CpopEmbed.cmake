@@ -0,0 +1,33 @@
+# cpop_embed_xml(<target> <name> <file>)
+#
+# Generates the header cpop_embed/<name>.hpp declaring
+#   inline constexpr std::string_view <name>
+# with the contents of <file>, and adds it to the include path of <target>.
+# Pass the string_view to cpop::staticXml to parse the file while compiling.
+# CMake re-runs when the file changes.
+function(cpop_embed_xml target name file)
+  get_filename_component(source "${file}" ABSOLUTE)
+  file(READ "${source}" content)
+
+  set(delimiter "cpop_xml")
+  string(FIND "${content}" ")${delimiter}\"" clash)
+  if(NOT clash EQUAL -1)
+    message(FATAL_ERROR "cpop_embed_xml: ${file} contains the raw string delimiter )${delimiter}\"")
+  endif()
+
+  set(dir "${CMAKE_CURRENT_BINARY_DIR}/cpop_embed")
+  set(header "${dir}/${name}.hpp")
+  set(generated "#pragma once\n\n#include <string_view>\n\n// Generated by cpop_embed_xml from ${source}\ninline constexpr std::string_view ${name} = R\"${delimiter}(${content})${delimiter}\";\n")
+
+  # Only rewrite when changed so that dependents are not rebuilt on every configure
+  set(existing "")
+  if(EXISTS "${header}")
+    file(READ "${header}" existing)
+  endif()
+  if(NOT existing STREQUAL generated)
+    file(WRITE "${header}" "${generated}")
+  endif()
+
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${source}")
+  target_include_directories(${target} PRIVATE "${dir}")
+endfunction()
@@ -0,0 +1,403 @@
+#pragma once
+
+#include "cpop/error.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/concepts.hpp"
+#include "cpop/parsers/xml_parser.hpp"
+
+#include <boost/pfr/core.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Composing one config from layered fragments, e.g. a base config, per region overrides and per host overrides.
+namespace cpop
+{
+
+// How elements of an overlay combine with elements of the same key in the base:
+//  - nested elements merge recursively and values of the overlay replace values of the base
+//  - children of elements whose key is in list_keys are appended (the list_key of a Multiple or Map)
+//  - elements whose key is in replace_keys replace the whole base element
+//  - elements missing from the base are appended
+struct MergeRules {
+    std::unordered_set<std::string> list_keys;
+    std::unordered_set<std::string> replace_keys;
+    // <include>path</include> is replaced by the children of that file's top level element. The level holding it
+    // merges over them like an overlay, so the including file overrides what it includes.
+    std::string include_key = "include";
+
+    bool operator==(const MergeRules&) const = default;
+};
+
+namespace detail {
+    template<typename T>
+    void collectListKeys(MergeRules& rules, std::unordered_set<const void*>& visited) {
+        static constexpr char tag{};
+        if (!visited.insert(&tag).second) {
+            return;
+        }
+
+        const auto collectNested = [&]<typename ValueType>(std::type_identity<ValueType> /*type*/) {
+            if constexpr (StructType<ValueType>) {
+                collectListKeys<ValueType>(rules, visited);
+            }
+        };
+
+        const T obj{};
+        boost::pfr::for_each_field(obj, [&](const auto& field) {
+            using FieldType = std::remove_cvref_t<decltype(field)>;
+
+            if constexpr (MultipleType<FieldType>) {
+                rules.list_keys.insert(field.list_key);
+                collectNested(std::type_identity<typename FieldType::value_type>{});
+            }
+            else if constexpr (MapType<FieldType>) {
+                rules.list_keys.insert(field.list_key);
+                collectNested(std::type_identity<typename FieldType::mapped_type>{});
+            }
+            else if constexpr (RequiredParamType<FieldType> || OptionalParamType<FieldType>) {
+                collectNested(std::type_identity<typename FieldType::value_type>{});
+            }
+        });
+    }
+}
+
+// Rules that append the lists of every Multiple and Map field of T (and of the structs nested in it)
+template<typename T>
+MergeRules mergeRulesFor() {
+    MergeRules rules;
+    std::unordered_set<const void*> visited;
+    detail::collectListKeys<T>(rules, visited);
+    return rules;
+}
+
+namespace detail {
+    template<typename Overlay> // Tree to move elements out of the overlay, const Tree to copy them
+    void mergeLevels(Tree& base, Overlay& overlay, const MergeRules& rules) {
+        constexpr bool kMove = !std::is_const_v<Overlay>;
+        const auto take = [](auto& elem) -> Element {
+            if constexpr (kMove) {
+                return std::move(elem);
+            } else if (const auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                return {.key = elem.key, .content = copyTree(*children), .symbol = elem.symbol, .offset = elem.offset};
+            } else {
+                return elem;
+            }
+        };
+
+        struct Pending {
+            Tree* base;
+            Overlay* overlay;
+        };
+
+        std::vector<Pending> pending{{&base, &overlay}};
+        while (!pending.empty()) {
+            const auto [baseLevel, overlayLevel] = pending.back();
+            pending.pop_back();
+
+            // Reserving up front keeps the views of the index valid while appending
+            baseLevel->reserve(baseLevel->size() + overlayLevel->size());
+            std::unordered_map<std::string_view, std::size_t> firstIndex;
+            for (std::size_t i = 0; i < baseLevel->size(); ++i) {
+                firstIndex.try_emplace((*baseLevel)[i].key, i);
+            }
+
+            for (auto& elem : *overlayLevel) {
+                const auto found = firstIndex.find(elem.key);
+                if (found == firstIndex.end()) {
+                    baseLevel->push_back(take(elem));
+                    firstIndex.try_emplace(baseLevel->back().key, baseLevel->size() - 1);
+                    continue;
+                }
+
+                auto& target = (*baseLevel)[found->second];
+                auto* targetChildren = std::get_if<std::vector<Element>>(&target.content);
+                auto* overlayChildren = std::get_if<std::vector<Element>>(&elem.content);
+                if (targetChildren == nullptr || overlayChildren == nullptr || rules.replace_keys.contains(elem.key)) {
+                    target.content = take(elem).content;
+                }
+                else if (rules.list_keys.contains(elem.key)) {
+                    targetChildren->reserve(targetChildren->size() + overlayChildren->size());
+                    for (auto& child : *overlayChildren) {
+                        targetChildren->push_back(take(child));
+                    }
+                }
+                else {
+                    pending.push_back({targetChildren, overlayChildren});
+                }
+            }
+        }
+    }
+}
+
+// Merges overlay into base. Only the levels of base that the overlay touches are visited,
+// so the cost is proportional to the size of the overlay plus the width of those levels.
+inline void mergeTree(Tree& base, Tree&& overlay, const MergeRules& rules = {}) {
+    detail::mergeLevels(base, overlay, rules);
+    destroyTree(std::move(overlay));
+}
+
+// Like above, copying what the overlay adds to base, so that overlay may stay shared, e.g. in a FragmentCache
+inline void mergeTree(Tree& base, const Tree& overlay, const MergeRules& rules = {}) {
+    detail::mergeLevels(base, overlay, rules);
+}
+
+namespace detail {
+    // A file a composition was built from, with the tree parsed from it at the time
+    struct FragmentUse {
+        std::filesystem::path path;
+        std::shared_ptr<const Tree> tree;
+    };
+
+    // Shares a tree that is torn down with destroyTree once the last owner lets go of it
+    inline std::shared_ptr<const Tree> shareTree(Tree tree) {
+        return {new Tree(std::move(tree)), [](const Tree* shared) {
+            const std::unique_ptr<Tree> owned(const_cast<Tree*>(shared)); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+            destroyTree(std::move(*owned));
+        }};
+    }
+}
+
+class FragmentCache;
+
+std::shared_ptr<const Tree> composeFiles(FragmentCache& cache, const std::vector<std::filesystem::path>& layers,
+                                         const MergeRules& rules = {});
+
+// Cache of parsed fragments keyed by path. A fragment is only re-read when its modification time or size
+// changed, and only re-parsed when its content hash changed as well. Parsed fragments are shared and never
+// modified, and so are the compositions of them that composeFiles keeps here.
+class FragmentCache {
+public:
+    std::shared_ptr<const Tree> load(const std::filesystem::path& path) {
+        const auto key = std::filesystem::absolute(path).lexically_normal().string();
+        std::error_code error;
+        const auto mtime = std::filesystem::last_write_time(path, error);
+        const auto size = std::filesystem::file_size(path, error);
+        if (error) {
+            throw ParseError("cannot open file " + path.string(), 0);
+        }
+
+        {
+            const std::lock_guard lock(mutex_);
+            const auto& entry = entries_[key];
+            if (entry.tree && entry.mtime == mtime && entry.size == size) {
+                return entry.tree;
+            }
+        }
+
+        // Reading and parsing happen outside of the lock, so fragments load concurrently. Entries are looked up
+        // again after that, as another thread may have loaded the same fragment or cleared the cache meanwhile.
+        const auto content = read(path);
+        const auto hash = fnv1a(content);
+        {
+            const std::lock_guard lock(mutex_);
+            if (auto& entry = entries_[key]; entry.tree && entry.hash == hash) {
+                entry.mtime = mtime;
+                entry.size = size;
+                return entry.tree;
+            }
+        }
+
+        const auto tree = detail::shareTree(XMLParser::parse(content));
+
+        const std::lock_guard lock(mutex_);
+        auto& entry = entries_[key];
+        if (!entry.tree || entry.hash != hash) {
+            entry.tree = tree;
+            entry.hash = hash;
+            ++parses_;
+        }
+        entry.mtime = mtime;
+        entry.size = size;
+        return entry.tree;
+    }
+
+    // Number of fragments actually parsed so far
+    [[nodiscard]] std::size_t parses() const {
+        const std::lock_guard lock(mutex_);
+        return parses_;
+    }
+
+    void clear() {
+        const std::lock_guard lock(mutex_);
+        entries_.clear();
+        compositions_.clear();
+    }
+
+private:
+    friend std::shared_ptr<const Tree> composeFiles(FragmentCache& cache,
+        const std::vector<std::filesystem::path>& layers, const MergeRules& rules);
+
+    struct Composition {
+        MergeRules rules;
+        std::vector<detail::FragmentUse> fragments; // layers and the files they include
+        std::shared_ptr<const Tree> tree;
+    };
+
+    struct Entry {
+        std::filesystem::file_time_type mtime;
+        std::uintmax_t size = 0;
+        std::uint64_t hash = 0;
+        std::shared_ptr<const Tree> tree;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_map<std::string, Composition> compositions_; // keyed by the paths of the layers
+    std::size_t parses_ = 0;
+
+    static std::string read(const std::filesystem::path& path) {
+        const detail::stats::Timer timer(&Stats::read_time);
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw ParseError("cannot open file " + path.string(), 0);
+        }
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    static std::uint64_t fnv1a(std::string_view content) {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (const char c : content) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+};
+
+namespace detail {
+    inline std::shared_ptr<const Tree> loadFragment(FragmentCache& cache, const std::filesystem::path& path,
+        const MergeRules& rules, std::vector<std::filesystem::path>& includeChain, std::vector<FragmentUse>& fragments);
+
+    inline bool hasIncludes(const Tree& tree, const std::string& include_key) {
+        std::vector<const Tree*> pending{&tree};
+        while (!pending.empty()) {
+            const Tree* level = pending.back();
+            pending.pop_back();
+            for (const auto& elem : *level) {
+                if (const auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                    pending.push_back(children);
+                } else if (elem.key == include_key) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Replaces include elements with the content of the files they name, relative to the including file. The level
+    // that holds an include is merged over the included content, so the including file's own values take precedence.
+    inline void resolveIncludes(Tree& tree, FragmentCache& cache, const std::filesystem::path& path, const MergeRules& rules,
+                                std::vector<std::filesystem::path>& includeChain, std::vector<FragmentUse>& fragments) {
+        std::vector<Tree*> levels{&tree};
+        for (std::size_t i = 0; i < levels.size(); ++i) {
+            for (auto& elem : *levels[i]) {
+                if (auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                    levels.push_back(children);
+                }
+            }
+        }
+
+        // Deeper levels first, so that a level is complete before it is merged over what its parent includes
+        for (auto* level : std::views::reverse(levels)) {
+            std::vector<std::filesystem::path> includes;
+            std::erase_if(*level, [&](const Element& elem) {
+                const auto* node = std::get_if<Node>(&elem.content);
+                if (elem.key != rules.include_key || node == nullptr) {
+                    return false;
+                }
+                includes.push_back(path.parent_path() / node->value);
+                return true;
+            });
+            if (includes.empty()) {
+                continue;
+            }
+
+            Tree resolved;
+            for (const auto& include : includes) {
+                const auto included = loadFragment(cache, include, rules, includeChain, fragments);
+                for (const auto& top : *included) {
+                    if (const auto* children = std::get_if<std::vector<Element>>(&top.content)) {
+                        mergeTree(resolved, *children, rules);
+                    }
+                }
+            }
+            mergeTree(resolved, std::move(*level), rules);
+            *level = std::move(resolved);
+        }
+    }
+
+    // The cached tree of path itself if it includes nothing, otherwise a copy with its includes resolved
+    inline std::shared_ptr<const Tree> loadFragment(FragmentCache& cache, const std::filesystem::path& path,
+        const MergeRules& rules, std::vector<std::filesystem::path>& includeChain, std::vector<FragmentUse>& fragments) {
+        const auto normalized = std::filesystem::absolute(path).lexically_normal();
+        if (std::ranges::find(includeChain, normalized) != includeChain.end()) {
+            throw ParseError("include cycle at " + path.string(), 0);
+        }
+
+        auto fragment = cache.load(path);
+        fragments.push_back({.path = normalized, .tree = fragment});
+        if (!hasIncludes(*fragment, rules.include_key)) {
+            return fragment;
+        }
+
+        includeChain.push_back(normalized);
+        Tree resolved = copyTree(*fragment);
+        resolveIncludes(resolved, cache, path, rules, includeChain, fragments);
+        includeChain.pop_back();
+        return shareTree(std::move(resolved));
+    }
+}
+
+// Loads each layer through the cache and merges them in order, later layers overriding earlier ones.
+// The composed tree is kept in the cache: as long as none of the files it was built from changed, composing the
+// same layers with the same rules again returns it without merging or copying anything.
+inline std::shared_ptr<const Tree> composeFiles(FragmentCache& cache, const std::vector<std::filesystem::path>& layers,
+                                                const MergeRules& rules) {
+    std::string key;
+    for (const auto& layer : layers) {
+        key.append(std::filesystem::absolute(layer).lexically_normal().string()).push_back('\n');
+    }
+
+    std::optional<FragmentCache::Composition> cached;
+    {
+        const std::lock_guard lock(cache.mutex_);
+        if (const auto found = cache.compositions_.find(key); found != cache.compositions_.end() && found->second.rules == rules) {
+            cached = found->second;
+        }
+    }
+    if (cached && std::ranges::all_of(cached->fragments, [&](const auto& use) { return cache.load(use.path) == use.tree; })) {
+        return cached->tree;
+    }
+
+    std::vector<detail::FragmentUse> fragments;
+    Tree result;
+    for (const auto& layer : layers) {
+        std::vector<std::filesystem::path> includeChain;
+        mergeTree(result, *detail::loadFragment(cache, layer, rules, includeChain, fragments), rules);
+    }
+    auto composed = detail::shareTree(std::move(result));
+
+    const std::lock_guard lock(cache.mutex_);
+    cache.compositions_.insert_or_assign(std::move(key),
+        FragmentCache::Composition{.rules = rules, .fragments = std::move(fragments), .tree = composed});
+    return composed;
+}
+
+}
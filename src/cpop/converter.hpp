@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ratio>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+// Customization point for converting node values to field types that cpop does not know about.
+//
+// Specialize cpop::Converter for your type and Param, OptParam and Multiple fields of that type will use it:
+//
+//   template<>
+//   struct cpop::Converter<IpAddress> {
+//       static std::optional<IpAddress> fromString(std::string_view value);
+//   };
+//
+// Built in are converters for std::chrono durations ("250ms"), byte sizes ("64MiB")
+// and enums with a name table (see EnumNames).
+namespace cpop
+{
+
+template<typename T>
+struct Converter {};
+
+// Specialize with a compile-time table of names to make an enum convertible. Names match case-insensitively.
+//
+//   template<>
+//   struct cpop::EnumNames<Level> {
+//       static constexpr std::array<std::pair<std::string_view, Level>, 2> names{{
+//           {"debug", Level::Debug}, {"info", Level::Info}}};
+//   };
+template<typename E>
+struct EnumNames {};
+
+// Byte count parsed from values like "512", "4KB" (SI, powers of 1000) or "64MiB" (IEC, powers of 1024)
+struct ByteSize {
+    std::uint64_t bytes = 0;
+
+    friend constexpr auto operator<=>(const ByteSize&, const ByteSize&) = default;
+};
+
+namespace detail {
+    constexpr bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < lhs.size(); ++i) {
+            if (std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr std::string_view trim(std::string_view value) {
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front())) != 0) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())) != 0) {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+
+    // Splits "250 ms" into {"250", "ms"}
+    constexpr std::pair<std::string_view, std::string_view> splitUnit(std::string_view value) {
+        value = trim(value);
+        const auto unit = value.find_first_not_of("+-0123456789.eE");
+        if (unit == std::string_view::npos) {
+            return {value, {}};
+        }
+        return {trim(value.substr(0, unit)), trim(value.substr(unit))};
+    }
+
+    template<typename Number>
+    std::optional<Number> parseNumber(std::string_view value) {
+        if (!value.empty() && value.front() == '+') {
+            value.remove_prefix(1);
+        }
+        Number result{};
+        const auto* end = value.data() + value.size();
+        const auto [ptr, ec] = std::from_chars(value.data(), end, result);
+        if (value.empty() || ec != std::errc{} || ptr != end) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    // Converts count * Unit into Target, rejecting values that overflow or that Target cannot represent exactly
+    template<typename Target, typename Unit>
+    std::optional<Target> scaleExactly(std::string_view number, Unit /*unit*/) {
+        using Rep = typename Target::rep;
+        using Scale = std::ratio_divide<Unit, typename Target::period>;
+
+        const auto integer = parseNumber<long long>(number);
+        if constexpr (std::is_integral_v<Rep> && Scale::den == 1) {
+            // Whole multiples stay in integer arithmetic so large counts keep full precision
+            if (integer) {
+                using Wide = std::conditional_t<std::is_signed_v<Rep>, long long, unsigned long long>;
+                constexpr Wide factor = Scale::num;
+                constexpr Wide max = std::numeric_limits<Rep>::max();
+                constexpr Wide min = std::numeric_limits<Rep>::min();
+
+                if (std::is_unsigned_v<Rep> && *integer < 0) {
+                    return std::nullopt;
+                }
+                const auto wide = static_cast<Wide>(*integer);
+                if (wide > max / factor || wide < min / factor) {
+                    return std::nullopt;
+                }
+                return Target{static_cast<Rep>(wide * factor)};
+            }
+        }
+
+        const auto count = integer ? std::optional<double>(static_cast<double>(*integer)) : parseNumber<double>(number);
+        if (!count) {
+            return std::nullopt;
+        }
+
+        const double scaled = *count * static_cast<double>(Scale::num) / static_cast<double>(Scale::den);
+        if constexpr (std::is_floating_point_v<Rep>) {
+            return Target{static_cast<Rep>(scaled)};
+        } else {
+            if (!std::isfinite(scaled) || scaled != std::trunc(scaled) ||
+                scaled < static_cast<double>(std::numeric_limits<Rep>::min()) ||
+                scaled >= static_cast<double>(std::numeric_limits<Rep>::max())) {
+                return std::nullopt;
+            }
+            return Target{static_cast<Rep>(scaled)};
+        }
+    }
+}
+
+template<typename Rep, typename Period>
+struct Converter<std::chrono::duration<Rep, Period>> {
+    using Duration = std::chrono::duration<Rep, Period>;
+
+    // A number followed by one of ns, us, ms, s, min, h or d. A unit is required.
+    static std::optional<Duration> fromString(std::string_view value) {
+        const auto [number, unit] = detail::splitUnit(value);
+        if (unit == "ns") { return detail::scaleExactly<Duration>(number, std::nano{}); }
+        if (unit == "us") { return detail::scaleExactly<Duration>(number, std::micro{}); }
+        if (unit == "ms") { return detail::scaleExactly<Duration>(number, std::milli{}); }
+        if (unit == "s") { return detail::scaleExactly<Duration>(number, std::ratio<1>{}); }
+        if (unit == "min") { return detail::scaleExactly<Duration>(number, std::ratio<60>{}); }
+        if (unit == "h") { return detail::scaleExactly<Duration>(number, std::ratio<3600>{}); }
+        if (unit == "d") { return detail::scaleExactly<Duration>(number, std::ratio<86400>{}); }
+        return std::nullopt;
+    }
+};
+
+template<>
+struct Converter<ByteSize> {
+    using Bytes = std::chrono::duration<std::uint64_t>; // Reuses the exact scaling of durations, one tick per byte
+
+    // A number optionally followed by B, KB, MB, GB, TB, PB or KiB, MiB, GiB, TiB, PiB (case-insensitive)
+    static std::optional<ByteSize> fromString(std::string_view value) {
+        const auto [number, unit] = detail::splitUnit(value);
+        if (!number.empty() && number.front() == '-') {
+            return std::nullopt;
+        }
+
+        const auto bytes = [&]() -> std::optional<Bytes> {
+            using detail::equalsIgnoreCase;
+            if (unit.empty() || equalsIgnoreCase(unit, "B")) { return detail::scaleExactly<Bytes>(number, std::ratio<1>{}); }
+            if (equalsIgnoreCase(unit, "KB")) { return detail::scaleExactly<Bytes>(number, std::kilo{}); }
+            if (equalsIgnoreCase(unit, "MB")) { return detail::scaleExactly<Bytes>(number, std::mega{}); }
+            if (equalsIgnoreCase(unit, "GB")) { return detail::scaleExactly<Bytes>(number, std::giga{}); }
+            if (equalsIgnoreCase(unit, "TB")) { return detail::scaleExactly<Bytes>(number, std::tera{}); }
+            if (equalsIgnoreCase(unit, "PB")) { return detail::scaleExactly<Bytes>(number, std::peta{}); }
+            if (equalsIgnoreCase(unit, "KiB")) { return detail::scaleExactly<Bytes>(number, std::ratio<1LL << 10>{}); }
+            if (equalsIgnoreCase(unit, "MiB")) { return detail::scaleExactly<Bytes>(number, std::ratio<1LL << 20>{}); }
+            if (equalsIgnoreCase(unit, "GiB")) { return detail::scaleExactly<Bytes>(number, std::ratio<1LL << 30>{}); }
+            if (equalsIgnoreCase(unit, "TiB")) { return detail::scaleExactly<Bytes>(number, std::ratio<1LL << 40>{}); }
+            if (equalsIgnoreCase(unit, "PiB")) { return detail::scaleExactly<Bytes>(number, std::ratio<1LL << 50>{}); }
+            return std::nullopt;
+        }();
+
+        if (!bytes) {
+            return std::nullopt;
+        }
+        return ByteSize{bytes->count()};
+    }
+};
+
+template<typename E>
+    requires std::is_enum_v<E> && requires { EnumNames<E>::names; }
+struct Converter<E> {
+    static std::optional<E> fromString(std::string_view value) {
+        value = detail::trim(value);
+        for (const auto& [name, enumerator] : EnumNames<E>::names) {
+            if (detail::equalsIgnoreCase(name, value)) {
+                return enumerator;
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "cpop/converter.hpp"
 #include "cpop/params.hpp"
 
 #include <concepts>
+#include <cstddef>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 namespace cpop::detail {
@@ -11,8 +15,12 @@ namespace cpop::detail {
   concept Numeric = std::integral<T> || std::floating_point<T>;
 
   template<typename T>
-    concept MultipleType = requires { typename T::value_type; } && 
-    std::same_as<T, Multiple<typename T::value_type>>;
+    concept MultipleType = requires { typename T::value_type; typename T::container_type; } && 
+    std::same_as<T, Multiple<typename T::value_type, typename T::container_type>>;
+
+  template<typename T>
+    concept MapType = requires { typename T::key_type; typename T::mapped_type; typename T::container_type; } &&
+    std::same_as<T, Map<typename T::key_type, typename T::mapped_type, typename T::container_type>>;
 
   template<typename T>
     concept OptionalParamType = requires { typename T::value_type; } && 
@@ -22,9 +30,24 @@ namespace cpop::detail {
     concept RequiredParamType = requires { typename T::value_type; } && 
     std::same_as<T, Param<typename T::value_type>>;
 
+  // std::string and allocator-aware strings such as std::pmr::string, which are assigned in place
+  template<typename T>
+    concept StringStorage = std::same_as<T, std::basic_string<char, std::char_traits<char>, typename T::allocator_type>>;
+
+  // Containers with a capacity fixed at compile time, such as cpop::InplaceVector
+  template<typename T>
+    concept FixedCapacityContainer = requires { { T::capacity() } -> std::convertible_to<std::size_t>; };
+
+  template<typename T>
+    concept HasConverter = requires(std::string_view value) {
+      { Converter<T>::fromString(value) } -> std::same_as<std::optional<T>>;
+    };
+
   template<typename T>
     concept StructType = !std::is_fundamental_v<T> && 
     !std::same_as<T, std::string> &&
+    !StringStorage<T> &&
+    !HasConverter<T> &&
     !OptionalParamType<T> &&
     !RequiredParamType<T>;
 }
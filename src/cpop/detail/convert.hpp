@@ -1,10 +1,12 @@
 #pragma once
 
 #include "cpop/error.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/detail/concepts.hpp"
 #include "cpop/detail/logger.hpp"
 
-#include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstddef>
 #include <exception>
 #include <format>
@@ -12,6 +14,8 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
 namespace cpop::detail {
@@ -19,11 +23,53 @@ namespace cpop::detail {
     public:
       template<typename T>
         static std::optional<T> tryConvert(std::string_view value) {
+          const stats::Timer timer(&Stats::convert_time);
+          auto result = convertValue<T>(value);
+          stats::addConversion(result ? conversionCounter<T>() : &Stats::Conversions::failed);
+          return result;
+        }
+
+      template<typename T>
+        static T convert(std::string_view value, const std::vector<std::string>& path = {}, std::size_t offset = kNoOffset) {
+          auto result = tryConvert<T>(value);
+          if (!result) {
+            throw PopulateError(conversionFailure<T>(value), path, offset);
+          }
+          return *result;
+        }
+
+      // A Converter may explain its failures with describeFailure, e.g. a value exceeding a fixed capacity
+      template<typename T = void>
+        static std::string conversionFailure(std::string_view value) {
+          if constexpr (requires { Converter<T>::describeFailure(value); }) {
+            if (!value.empty()) {
+              return Converter<T>::describeFailure(value);
+            }
+          }
+          return std::format("Failed to convert value: '{}' to required type", value);
+        }
+
+      // Assigns value to a string in place, so that the capacity and allocator of target are reused
+      template<StringStorage T>
+        static bool tryAssign(T& target, std::string_view value) {
+          const bool converted = !value.empty();
+          if (converted) {
+            target.assign(value.data(), value.size());
+          }
+          stats::addConversion(converted ? &Stats::Conversions::string : &Stats::Conversions::failed);
+          return converted;
+        }
+    private:
+      template<typename T>
+        static std::optional<T> convertValue(std::string_view value) {
           if (value.empty()) {
             return std::nullopt;
           }
 
-          if constexpr (std::is_same_v<T, bool>) {
+          if constexpr (HasConverter<T>) {
+            return Converter<T>::fromString(value);
+          }
+          else if constexpr (std::is_same_v<T, bool>) {
             return convertToBool(value);
           }
           else if constexpr (std::is_same_v<T, double>) {
@@ -47,106 +93,107 @@ namespace cpop::detail {
         }
 
       template<typename T>
-        static T convert(std::string_view value, const std::vector<std::string>& path = {}) {
-          auto result = tryConvert<T>(value);
-          if (!result) {
-            throw PopulateError(
-                std::format("Failed to convert value: '{}' to required type", value), 
-                path);
+        static constexpr auto conversionCounter() {
+          if constexpr (std::is_same_v<T, bool>) {
+            return &Stats::Conversions::boolean;
+          }
+          else if constexpr (std::is_same_v<T, std::string>) {
+            return &Stats::Conversions::string;
+          }
+          else if constexpr (std::is_floating_point_v<T>) {
+            return &Stats::Conversions::floating_point;
+          }
+          else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
+            return &Stats::Conversions::unsigned_integer;
+          }
+          else if constexpr (std::is_integral_v<T>) {
+            return &Stats::Conversions::signed_integer;
+          }
+          else {
+            return &Stats::Conversions::other;
           }
-          return *result;
         }
-    private:
+
       static std::string convertToString(std::string_view value) {
         return std::string(value);
       }
 
-      // Helper to check if string is completely consumed after conversion
-      static bool isFullyConsumed(std::string_view value, size_t pos) {
-        while (pos < value.length() && 
-               static_cast<bool>(std::isspace(value[pos]))) {
-          pos++;
+      // Leading and trailing whitespace and a leading '+' are accepted, like std::stoll and std::stod do
+      static std::string_view numberText(std::string_view value) {
+        value = trim(value);
+        if (value.size() > 1 && value.front() == '+' && value[1] != '-') {
+          value.remove_prefix(1);
         }
-        return pos == value.length();
+        return value;
       }
 
+      // Parses the whole of value without allocating
+      template<typename Number>
+        static std::optional<Number> parseWhole(std::string_view value) {
+          value = numberText(value);
+          Number result{};
+          const auto* end = value.data() + value.size();
+          const auto [ptr, ec] = std::from_chars(value.data(), end, result);
+          if (value.empty() || ec != std::errc{} || ptr != end) {
+            return std::nullopt;
+          }
+          return result;
+        }
+
       static std::optional<bool> convertToBool(std::string_view value) {
-        std::string lower{value};
-        std::ranges::transform(lower, lower.begin(), ::tolower);
-        if (lower == "true") {
+        if (equalsIgnoreCase(value, "true")) {
           return true;
         }
-        if (lower == "false") {
+        if (equalsIgnoreCase(value, "false")) {
           return false;
         }
         return std::nullopt;
       }
 
       static std::optional<double> convertToDouble(std::string_view value) {
-        std::size_t pos{};
-        try {
-          const double result = std::stod(convertToString(value), &pos);
-          return isFullyConsumed(value, pos) ? std::optional<double>{result} : std::nullopt;
-        }
-        catch (const std::exception&) {
-          return std::nullopt;
-        }
+        return parseWhole<double>(value);
       }
 
       template<typename T>
         static std::optional<T> convertToUnsigned(std::string_view value) {
           static_assert(std::is_unsigned_v<T>, "T must be unsigned");
 
-          try {
-            size_t pos{};
-            auto result = std::stoull(convertToString(value), &pos);
-
-            if (!isFullyConsumed(value, pos)) {
-              return std::nullopt;
-            }
-
-            if (result > std::numeric_limits<T>::max()) {
-              Logger::warn(std::format("Value '{}' exceeds maximum limit of type ({})", 
-                    result, std::to_string(std::numeric_limits<T>::max())));
-              return std::nullopt;
-            }
-
-            return static_cast<T>(result);
+          const auto result = parseWhole<unsigned long long>(value);
+          if (!result) {
+            return std::nullopt;
           }
-          catch (const std::exception&) {
+
+          if (*result > std::numeric_limits<T>::max()) {
+            Logger::warn(std::format("Value '{}' exceeds maximum limit of type ({})", 
+                  *result, std::to_string(std::numeric_limits<T>::max())));
             return std::nullopt;
           }
+
+          return static_cast<T>(*result);
         }
 
       template<typename T>
         static std::optional<T> convertToSigned(std::string_view value) {
           static_assert(std::is_signed_v<T>, "T must be signed");
 
-          try {
-            size_t pos{};
-            auto result = std::stoll(convertToString(value), &pos);
-
-            if (!isFullyConsumed(value, pos)) {
-              return std::nullopt;
-            }
-
-            if (result < std::numeric_limits<T>::min()) {
-              Logger::warn(std::format("Value '{}' exceeds minimum limit of type ({})", 
-                    result, std::to_string(std::numeric_limits<T>::min())));
-              return std::nullopt;
-            }
-
-            if (result > std::numeric_limits<T>::max()) {
-              Logger::warn(std::format("Value '{}' exceeds maximum limit of type ({})", 
-                    result, std::to_string(std::numeric_limits<T>::max())));
-              return std::nullopt;
-            }
+          const auto result = parseWhole<long long>(value);
+          if (!result) {
+            return std::nullopt;
+          }
 
-            return static_cast<T>(result);
+          if (*result < std::numeric_limits<T>::min()) {
+            Logger::warn(std::format("Value '{}' exceeds minimum limit of type ({})", 
+                  *result, std::to_string(std::numeric_limits<T>::min())));
+            return std::nullopt;
           }
-          catch (const std::exception&) {
+
+          if (*result > std::numeric_limits<T>::max()) {
+            Logger::warn(std::format("Value '{}' exceeds maximum limit of type ({})", 
+                  *result, std::to_string(std::numeric_limits<T>::max())));
             return std::nullopt;
           }
+
+          return static_cast<T>(*result);
         }
   };
 }
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "cpop/location.hpp"
+#include "cpop/stats.hpp"
 #include "cpop/detail/to_string_with_delims.hpp"
 
+#include <cstddef>
 #include <format>
 #include <print>
 #include <string>
@@ -11,9 +14,13 @@
 namespace cpop::detail {
   class Logger {
   public:
-      static void warn(std::string_view message, const std::vector<std::string>& path = {}) {
+      static void warn(std::string_view message, const std::vector<std::string>& path = {}, std::size_t offset = kNoOffset) {
+          stats::add(&Stats::warnings);
+
           std::string pathStr;
-          if (!path.empty()) {
+          if (!path.empty() && offset != kNoOffset) {
+              pathStr = std::format(" (at path: {}, offset {})", toStringWithDelims(path, " -> "), offset);
+          } else if (!path.empty()) {
               pathStr = std::format(" (at path: {})", toStringWithDelims(path, " -> "));
           }
           std::println("Warning: {}{}", message, pathStr);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cpop/error.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace cpop::detail {
+  struct PathSegment {
+      std::string_view key;
+      std::size_t index = 0; // Which of the siblings sharing `key` to select (zero based)
+  };
+
+  // Splits paths like "db_list/database[3]/port" into segments lazily, so walking a path never allocates
+  class PathReader {
+  public:
+      explicit PathReader(std::string_view path) : path_(path), rest_(path) {}
+
+      std::optional<PathSegment> next() {
+          if (done_) {
+              return std::nullopt;
+          }
+
+          const auto slash = rest_.find('/');
+          const auto token = rest_.substr(0, slash);
+          if (slash == std::string_view::npos) {
+              done_ = true;
+          } else {
+              rest_.remove_prefix(slash + 1);
+          }
+
+          return parseSegment(token);
+      }
+
+  private:
+      std::string_view path_;
+      std::string_view rest_;
+      bool done_ = false;
+
+      PathSegment parseSegment(std::string_view token) const {
+          PathSegment segment{.key = token};
+
+          const auto open = token.find('[');
+          if (open != std::string_view::npos) {
+              if (token.back() != ']') {
+                  fail("Unterminated index");
+              }
+              const auto digits = token.substr(open + 1, token.size() - open - 2);
+              const auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), segment.index);
+              if (digits.empty() || ec != std::errc{} || ptr != digits.data() + digits.size()) {
+                  fail("Invalid index");
+              }
+              segment.key = token.substr(0, open);
+          }
+
+          if (segment.key.empty()) {
+              fail("Empty key");
+          }
+          return segment;
+      }
+
+      [[noreturn]] void fail(std::string_view reason) const {
+          throw PopulateError(std::format("Malformed path: {}", reason), {std::string(path_)});
+      }
+  };
+}
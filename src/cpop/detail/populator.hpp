@@ -3,9 +3,14 @@
 #include "cpop/detail/convert.hpp"
 #include "cpop/detail/concepts.hpp"
 #include "cpop/error.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
 #include "cpop/tree.hpp"
 #include "cpop/detail/logger.hpp"
 
+#include <boost/pfr/core.hpp>
+
+#include <cstddef>
 #include <exception>
 #include <string>
 #include <string_view>
@@ -15,162 +20,736 @@
 #include <algorithm>
 #include <ranges>
 #include <format>
+#include <optional>
 #include <cassert>
+#include <utility>
+
+// Nested structs populate recursively, so a recursive config type fed a deep document would need one stack
+// frame per level. Deeper nesting is reported as a NestingDepthError to keep stack usage bounded.
+#ifndef CPOP_MAX_POPULATE_DEPTH
+#define CPOP_MAX_POPULATE_DEPTH 128
+#endif
+
+namespace cpop::detail {
+  inline constexpr std::size_t kMaxPopulateDepth = CPOP_MAX_POPULATE_DEPTH;
+
+  // One key of the path currently being populated. Frames live on the stack of the populating call
+  // and point at their parent, so population keeps no mutable state outside the call itself.
+  struct PathFrame {
+      std::string_view key;
+      const PathFrame* parent = nullptr;
+      std::size_t depth = 0; // number of nested structs entered to get here
+      std::size_t offset = kNoOffset; // of the element found for key in the source document
+  };
+
+  inline std::vector<std::string> toPath(const PathFrame* frame) {
+      std::vector<std::string> path;
+      for (; frame != nullptr; frame = frame->parent) {
+          path.emplace_back(frame->key);
+      }
+      std::ranges::reverse(path);
+      return path;
+  }
+
+  // A key that was not found is reported at the closest enclosing element with a known offset
+  inline std::size_t sourceOffset(const PathFrame* frame) {
+      for (; frame != nullptr; frame = frame->parent) {
+          if (frame->offset != kNoOffset) {
+              return frame->offset;
+          }
+      }
+      return kNoOffset;
+  }
+
+  inline PopulateError populateError(std::string_view message, const PathFrame& frame) {
+      return PopulateError(message, toPath(&frame), sourceOffset(&frame));
+  }
+
+  inline void warnAt(std::string_view message, const PathFrame& frame) {
+      Logger::warn(message, toPath(&frame), sourceOffset(&frame));
+  }
+
+  // An interned element only matches an interned key; the string is only compared for hand built elements
+  inline bool keyMatches(const Element& elem, std::string_view key, Symbol symbol) {
+      return elem.symbol != kNoSymbol ? elem.symbol == symbol : elem.key == key;
+  }
+
+  // Symbols of the keys of T's params, resolved once per struct type from a default constructed T.
+  // Objects the populator constructs itself have exactly those keys, so their symbols are taken by field slot alone.
+  // An object passed in by the caller may have keys changed at runtime, a key that differs is interned again.
+  template<typename T>
+  class KeySymbols {
+  public:
+      explicit KeySymbols(const T& obj) {
+          forEachKey(obj, [this](std::string_view key, bool in_level) {
+              keys_.push_back({.key = std::string(key), .symbol = SymbolTable::global().intern(key), .in_level = in_level});
+          });
+          for (auto& entry : keys_) {
+              entry.shared = entry.in_level && std::ranges::count_if(keys_, [&entry](const Entry& other) {
+                  return other.in_level && other.symbol == entry.symbol;
+              }) > 1;
+          }
+      }
+
+      static const KeySymbols& of(const T& obj) {
+          if constexpr (std::default_initializable<T>) {
+              static const KeySymbols symbols{T{}};
+              return symbols;
+          } else {
+              // Never constructed by the populator, so every object is checked against these keys
+              static const KeySymbols symbols(obj);
+              return symbols;
+          }
+      }
+
+      // For objects the populator constructed
+      [[nodiscard]] Symbol at(std::size_t slot) const { return keys_[slot].symbol; }
+
+      // For objects passed in by the caller
+      [[nodiscard]] Symbol at(std::size_t slot, std::string_view key) const {
+          if (keys_[slot].key == key) {
+              return keys_[slot].symbol;
+          }
+          return SymbolTable::global().intern(key);
+      }
+
+      // Whether another field looks up the element of slot in the same level, so that it must not be moved from
+      [[nodiscard]] bool shared(std::size_t slot) const { return keys_[slot].shared; }
+
+      // Whether obj has the keys of a default constructed T, so that shared() holds for it too
+      [[nodiscard]] bool sameKeys(const T& obj) const {
+          std::size_t slot = 0;
+          bool same = true;
+          forEachKey(obj, [this, &slot, &same](std::string_view key, bool /*in_level*/) {
+              same = same && keys_[slot++].key == key;
+          });
+          return same;
+      }
 
-namespace cpop::detail { 
-  class Populator {
   private:
-      const Tree& tree_;
-      mutable std::vector<std::string> current_path_;
+      struct Entry {
+          std::string key;
+          Symbol symbol;
+          bool in_level;       // looked up in the level of the struct rather than in a list below it
+          bool shared = false;
+      };
+
+      std::vector<Entry> keys_;
+
+      // Visits the keys of obj in slot order
+      template<typename Visit>
+      static void forEachKey(const T& obj, Visit&& visit) {
+          boost::pfr::for_each_field(obj, [&visit](const auto& field) {
+              using FieldType = std::remove_cvref_t<decltype(field)>;
+
+              if constexpr (RequiredParamType<FieldType> || OptionalParamType<FieldType>) {
+                  visit(field.key, true);
+              }
+              else if constexpr (MultipleType<FieldType>) {
+                  visit(field.list_key, true);
+                  visit(field.element_key, false);
+              }
+              else if constexpr (MapType<FieldType>) {
+                  visit(field.list_key, true);
+                  visit(field.element_key, false);
+                  visit(field.keyName(), false);
+              }
+          });
+      }
+  };
+
+  inline constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+  // Where each field of one struct type was found the last time it was populated, together with
+  // the shape (the sequence of child keys) of the level it was populated from.
+  struct PopulatePlan {
+      struct Slot {
+          Symbol symbol = kNoSymbol;
+          std::size_t position = kNotFound;
+      };
+
+      std::vector<Symbol> shape;
+      std::vector<Slot> slots; // indexed like KeySymbols
+      bool in_use = false;     // set while a level is populated with this plan
+  };
+
+  // Finds the fields of one struct in one level. If the level has the shape recorded in the plan, a field whose key
+  // is unchanged is taken from its recorded position without searching. Otherwise fields are searched for as usual
+  // and the plan is re-recorded. As a recorded position is the first element with that key, both give the same result.
+  template<typename Access>
+  class PlannedLookup {
+  public:
+      using Level = typename Access::Level;
+      using Item = typename Access::Item;
+
+      PlannedLookup(PopulatePlan& plan, Level level) : plan_(plan), level_(level) {
+          // A recursive struct type reaches the same plan again further down, which then just searches
+          if (plan.in_use) {
+              return;
+          }
+
+          const auto size = Access::size(level);
+          stats::add(&Stats::lookup_comparisons, size);
+          bool same = plan.shape.size() == size;
+          for (std::size_t i = 0; i < size; ++i) {
+              const auto symbol = Access::symbolAt(level, i);
+              if (symbol == kNoSymbol) {
+                  return; // hand built elements compare by string, their positions are not recorded
+              }
+              same = same && plan.shape[i] == symbol;
+          }
 
-      void pushPath(std::string_view key) const {
-          current_path_.emplace_back(key);
+          mode_ = same ? Mode::Follow : Mode::Record;
+          if (!same) {
+              plan.shape.resize(size);
+              for (std::size_t i = 0; i < size; ++i) {
+                  plan.shape[i] = Access::symbolAt(level, i);
+              }
+              plan.slots.clear();
+          }
+          plan.in_use = true;
       }
 
-      void popPath() const {
-          if (!current_path_.empty()) {
-              current_path_.pop_back();
+      PlannedLookup(const PlannedLookup&) = delete;
+      PlannedLookup& operator=(const PlannedLookup&) = delete;
+      PlannedLookup(PlannedLookup&&) = delete;
+      PlannedLookup& operator=(PlannedLookup&&) = delete;
+
+      ~PlannedLookup() {
+          if (mode_ != Mode::Off) {
+              plan_.in_use = false;
           }
       }
 
-      static auto findInTree(const Tree& tree, std::string_view key) {
-          return std::ranges::find_if(tree, [key](const auto& elem) { 
-              return elem.key == key; 
+      Item find(std::size_t slot, std::string_view key, Symbol symbol) {
+          if (mode_ == Mode::Follow && slot < plan_.slots.size() && plan_.slots[slot].symbol == symbol) {
+              stats::add(&Stats::planned_lookups);
+              return item(plan_.slots[slot].position);
+          }
+
+          const auto position = Access::findIndex(level_, key, symbol);
+          if (mode_ != Mode::Off) {
+              if (plan_.slots.size() <= slot) {
+                  plan_.slots.resize(slot + 1);
+              }
+              plan_.slots[slot] = {.symbol = symbol, .position = position};
+          }
+          return item(position);
+      }
+
+  private:
+      enum class Mode { Off, Record, Follow };
+
+      PopulatePlan& plan_;
+      Level level_;
+      Mode mode_ = Mode::Off;
+
+      Item item(std::size_t position) const {
+          return position == kNotFound ? nullptr : Access::at(level_, position);
+      }
+  };
+
+  // How BasicPopulator reads a cpop::Tree. A level is a list of elements and an item is one element of it.
+  //
+  // The default access only ever reads the tree, so any number of populators may work on the same const Tree
+  // concurrently. Moving access (Move = true) instead moves string values out of a tree that is about
+  // to be discarded, avoiding a copy of every string, except where more than one field reads an element.
+  template<bool Move>
+  struct TreeAccess {
+      using Level = std::conditional_t<Move, Tree*, const Tree*>;
+      using Item = std::conditional_t<Move, Element*, const Element*>;
+
+      static constexpr bool kMovesStrings = Move;
+
+      // Cleared for elements that more than one field reads and everything below them, which are copied instead
+      bool moves = Move;
+
+      static std::size_t findIndex(Level level, std::string_view key, Symbol symbol) {
+          auto iter = std::ranges::find_if(*level, [key, symbol](const auto& elem) {
+              return keyMatches(elem, key, symbol);
           });
+          stats::add(&Stats::lookup_comparisons,
+              static_cast<std::size_t>(iter - level->begin()) + (iter == level->end() ? 0 : 1));
+          return iter == level->end() ? kNotFound : static_cast<std::size_t>(iter - level->begin());
+      }
+
+      static std::size_t size(Level level) { return level->size(); }
+      static Symbol symbolAt(Level level, std::size_t index) { return (*level)[index].symbol; }
+      static Item at(Level level, std::size_t index) { return &(*level)[index]; }
+
+      template<typename Visit>
+      static void forEachMatching(Level level, std::string_view key, Symbol symbol, Visit&& visit) {
+          stats::add(&Stats::lookup_comparisons, level->size());
+          for (auto& elem : *level) {
+              if (keyMatches(elem, key, symbol)) {
+                  visit(&elem);
+              }
+          }
+      }
+
+      static bool isNested(Item item) { return std::holds_alternative<std::vector<Element>>(item->content); }
+      static bool isValue(Item item) { return std::holds_alternative<Node>(item->content); }
+      static Level children(Item item) { return &std::get<std::vector<Element>>(item->content); }
+      static std::string_view value(Item item) { return std::get<Node>(item->content).value; }
+      static std::size_t offset(Item item) { return item->offset.get(); }
+
+      template<typename ValueType>
+      std::optional<ValueType> tryTakeValue(Item item) const {
+          auto& node_value = std::get<Node>(item->content).value;
+          if constexpr (Move && std::is_same_v<ValueType, std::string>) {
+              if (!moves || node_value.empty()) {
+                  return TypeConverter::tryConvert<ValueType>(node_value);
+              }
+              stats::addConversion(&Stats::Conversions::string);
+              return std::move(node_value);
+          } else {
+              return TypeConverter::tryConvert<ValueType>(node_value);
+          }
+      }
+
+      // Hook for accesses that can reuse earlier results, here a nested struct is always populated afresh
+      template<typename ValueType, typename Populate>
+      static void populateNested(ValueType& value, Item /*item*/, Populate&& populate) {
+          std::forward<Populate>(populate)(value);
+      }
+  };
+
+  // Populates one struct from one level of a tree, read through Access (see TreeAccess).
+  template<typename Access>
+  class BasicPopulator {
+  private:
+      using Level = typename Access::Level;
+      using Item = typename Access::Item;
+
+      Access access_;
+      Level level_;
+      const PathFrame* parent_;
+      std::size_t depth_;
+
+      // Strings are assigned in place to reuse their capacity and allocator, unless the access moves them out of
+      // the tree. Other values are converted and assigned, so target is left unchanged if conversion fails.
+      template<typename ValueType>
+      bool tryAssignValue(ValueType& target, Item item) const {
+          if constexpr (StringStorage<ValueType> && !(Access::kMovesStrings && std::is_same_v<ValueType, std::string>)) {
+              return TypeConverter::tryAssign(target, access_.value(item));
+          } else {
+              auto converted = access_.template tryTakeValue<ValueType>(item);
+              if (!converted) {
+                  return false;
+              }
+              target = std::move(*converted);
+              return true;
+          }
+      }
+
+      std::size_t offsetOf(Item item) const {
+          return item == nullptr ? kNoOffset : access_.offset(item);
       }
 
       template<typename ValueType>
-      auto populateValue(const Element& element) const {
-          if (!std::holds_alternative<Node>(element.content)) {
-              throw PopulateError("Expected Node type", current_path_);
+      void populateValue(ValueType& value, Item item, const PathFrame& frame) const {
+          if (!access_.isValue(item)) {
+              throw populateError("Expected Node type", frame);
           }
 
-          const auto& node_value = std::get<Node>(element.content).value;
-          return TypeConverter::convert<ValueType>(node_value, current_path_);
+          if (!tryAssignValue(value, item)) {
+              throw populateError(TypeConverter::conversionFailure<ValueType>(access_.value(item)), frame);
+          }
       }
 
       template<typename ValueType>
-      void populateNested(ValueType& value, const Element& element) const {
-          if (!std::holds_alternative<std::vector<Element>>(element.content)) {
-              throw PopulateError("Expected nested structure", current_path_);
+      bool tryAssignOptional(std::optional<ValueType>& target, Item item) const {
+          if constexpr (StringStorage<ValueType>) {
+              const bool had_value = target.has_value();
+              if (!had_value) {
+                  target.emplace();
+              }
+              const bool assigned = tryAssignValue(*target, item);
+              if (!assigned && !had_value) {
+                  target.reset();
+              }
+              return assigned;
+          } else {
+              auto converted = access_.template tryTakeValue<ValueType>(item);
+              if (converted) {
+                  target = std::move(*converted);
+              }
+              return converted.has_value();
+          }
+      }
+
+      // Whether values can take another item, lists of fixed capacity fill up
+      template<typename Container>
+      static bool hasRoom(const Container& values) {
+          if constexpr (FixedCapacityContainer<Container>) {
+              return values.size() < values.capacity();
+          } else {
+              return true;
           }
-          populateFromTree(value, std::get<std::vector<Element>>(element.content));
+      }
+
+      enum class Appended { yes, failed, full };
+
+      // Strings are constructed in place, so that a container with an allocator passes it on to them.
+      // Room is checked once the value converted, so that items that fail conversion take none.
+      template<typename Container>
+      Appended appendValue(Container& values, Item item) const {
+          using ItemType = typename Container::value_type;
+          if constexpr (StringStorage<ItemType> && !(Access::kMovesStrings && std::is_same_v<ItemType, std::string>)) {
+              const auto text = access_.value(item);
+              stats::addConversion(text.empty() ? &Stats::Conversions::failed : &Stats::Conversions::string);
+              if (text.empty()) {
+                  return Appended::failed;
+              }
+              if (!hasRoom(values)) {
+                  return Appended::full;
+              }
+              values.emplace_back(text);
+              return Appended::yes;
+          } else {
+              auto converted = access_.template tryTakeValue<ItemType>(item);
+              if (!converted) {
+                  return Appended::failed;
+              }
+              if (!hasRoom(values)) {
+                  return Appended::full;
+              }
+              values.push_back(std::move(*converted));
+              return Appended::yes;
+          }
+      }
+
+      // kConstructed: value was constructed by the populator rather than passed in by the caller, see KeySymbols
+      template<bool kConstructed, typename ValueType>
+      void populateNested(ValueType& value, Item item, const PathFrame& frame) const {
+          if (!access_.isNested(item)) {
+              throw populateError("Expected nested structure", frame);
+          }
+          if (frame.depth >= kMaxPopulateDepth) {
+              throw NestingDepthError("Maximum nesting depth exceeded", toPath(&frame), sourceOffset(&frame));
+          }
+          access_.populateNested(value, item, [&](ValueType& target) {
+              BasicPopulator(access_.children(item), &frame, access_).template populateFields<kConstructed>(target);
+          });
       }
 
   public:
-      explicit Populator(const Tree& tree) : tree_(tree) {}
+      explicit BasicPopulator(Level level, const PathFrame* parent = nullptr, Access access = {})
+          : access_(std::move(access)), level_(level), parent_(parent),
+            depth_(parent == nullptr ? 0 : parent->depth + 1) {}
 
-      template<RequiredParamType Field>
-      void populateRequired(Field& field) const {
-          using ValueType = typename std::remove_cvref_t<decltype(field.value)>;
+      // Populates obj, which may have keys that differ from those of a default constructed T
+      template<typename T>
+      void populate(T& obj) const {
+          populateFields<false>(obj);
+      }
 
-          pushPath(field.key);
+      // One per struct type, shared by objects passed in and constructed, so that a recursive type meets its own plan.
+      // Per thread, so that threads populating the same type concurrently need no synchronization.
+      template<typename T>
+      static PopulatePlan& planOf() {
+          thread_local PopulatePlan plan;
+          return plan;
+      }
+
+      template<bool kConstructed, typename T>
+      void populateFields(T& obj) const {
+          const auto& symbols = KeySymbols<T>::of(obj);
+          PlannedLookup<Access> lookup(planOf<T>(), level_);
+          std::size_t slot = 0;
+
+          const auto symbolOf = [&symbols](std::size_t index, std::string_view key) {
+              if constexpr (kConstructed) {
+                  (void)key;
+                  return symbols.at(index);
+              } else {
+                  return symbols.at(index, key);
+              }
+          };
+
+          // Moving access copies from elements that another field reads as well. An object passed in with keys of
+          // its own may share them in ways KeySymbols does not know of, so it is copied into as a whole.
+          BasicPopulator copying = *this;
+          bool copy_all = false;
+          if constexpr (Access::kMovesStrings) {
+              copying.access_.moves = false;
+              copy_all = !kConstructed && !symbols.sameKeys(obj);
+          }
+          const auto reader = [this, &copying, copy_all, &symbols](std::size_t index) -> const BasicPopulator& {
+              if constexpr (Access::kMovesStrings) {
+                  if (copy_all || symbols.shared(index)) {
+                      return copying;
+                  }
+              }
+              (void)index;
+              return *this;
+          };
+
+          boost::pfr::for_each_field(obj, [&lookup, &slot, &symbolOf, &reader](auto& field) {
+              using FieldType = std::remove_cvref_t<decltype(field)>;
+
+              if constexpr (RequiredParamType<FieldType>) {
+                  const auto& populator = reader(slot);
+                  const auto symbol = symbolOf(slot, field.key);
+                  populator.populateRequired(field.value, field.key, lookup.find(slot++, field.key, symbol));
+              }
+              else if constexpr (OptionalParamType<FieldType>) {
+                  const auto& populator = reader(slot);
+                  const auto symbol = symbolOf(slot, field.key);
+                  populator.populateOptional(field, lookup.find(slot++, field.key, symbol));
+              }
+              else if constexpr (MultipleType<FieldType>) {
+                  const auto& populator = reader(slot);
+                  const auto list_symbol = symbolOf(slot, field.list_key);
+                  const auto list = lookup.find(slot++, field.list_key, list_symbol);
+                  populator.populateMultiple(field, list, symbolOf(slot++, field.element_key));
+              }
+              else if constexpr (MapType<FieldType>) {
+                  const auto& populator = reader(slot);
+                  const auto list_symbol = symbolOf(slot, field.list_key);
+                  const auto list = lookup.find(slot++, field.list_key, list_symbol);
+                  const auto element_symbol = symbolOf(slot++, field.element_key);
+                  populator.populateMap(field, list, element_symbol, symbolOf(slot++, field.keyName()));
+              }
+
+              // skip fields that are not params
+          });
+      }
+
+      // Populates value directly from the element with the given key, used to populate an object
+      // from the top level element of a document
+      template<typename ValueType>
+      void populateRequired(ValueType& value, std::string_view key, Symbol symbol) const {
+          const auto position = access_.findIndex(level_, key, symbol);
+          populateRequired(value, key, position == kNotFound ? nullptr : access_.at(level_, position));
+      }
+
+      // Populates value from item, the element found for key, used for Param fields
+      template<typename ValueType>
+      void populateRequired(ValueType& value, std::string_view key, Item item) const {
+          const PathFrame frame{key, parent_, depth_, offsetOf(item)};
           try {
-              auto iter = findInTree(tree_, field.key);
-              if (iter == tree_.end()) {
-                  throw PopulateError("Required key not found", current_path_);
+              if (item == nullptr) {
+                  throw populateError("Required key not found", frame);
               }
 
               if constexpr (StructType<ValueType>) {
-                  populateNested(field.value, *iter);
+                  // populated in place, so a Param<Struct> of an object passed in keeps its keys
+                  populateNested<false>(value, item, frame);
               } else {
-                  field.value = populateValue<ValueType>(*iter);
+                  populateValue(value, item, frame);
               }
           }
           catch (const PopulateError&) {
               throw;
           }
           catch (const std::exception& e) {
-              throw PopulateError(e.what(), current_path_);
+              throw populateError(e.what(), frame);
           }
-          popPath();
       }
 
       template<OptionalParamType Field>
-      void populateOptional(Field& field) const {
+      void populateOptional(Field& field, Item item) const {
           using OptionalType = typename std::remove_cvref_t<decltype(field.value)>::value_type;
 
-          pushPath(field.key);
+          const PathFrame frame{field.key, parent_, depth_, offsetOf(item)};
           try {
-              auto iter = findInTree(tree_, field.key);
-              if (iter == tree_.end()) {
-                  popPath();
+              // Like a present one, a missing key replaces what the field held before, e.g. on reload
+              if (item == nullptr) {
+                  field.value.reset();
                   return;
               }
 
               if constexpr (StructType<OptionalType>) {
-                  if (std::holds_alternative<std::vector<Element>>(iter->content)) {
+                  if (access_.isNested(item)) {
                       OptionalType nestedObj;
-                      populateNested(nestedObj, *iter);
+                      populateNested<true>(nestedObj, item, frame);
                       field.value = std::move(nestedObj);
                   } else {
-                      Logger::warn("Optional nested structure found but has wrong type", current_path_);
+                      warnAt("Optional nested structure found but has wrong type", frame);
                   }
               } else {
-                  if (std::holds_alternative<Node>(iter->content)) {
-                      const auto& node = std::get<Node>(iter->content);
-                      auto converted = TypeConverter::tryConvert<OptionalType>(node.value);
-                      if (converted) {
-                          field.value = std::move(*converted);
-                      } else {
-                          Logger::warn(std::format(
-                              "Failed to convert optional parameter with value '{}'", 
-                              node.value), current_path_);
+                  if (access_.isValue(item)) {
+                      if (!tryAssignOptional(field.value, item)) {
+                          warnAt(std::format(
+                              "Failed to convert optional parameter with value '{}'",
+                              access_.value(item)), frame);
                       }
                   } else {
-                      Logger::warn("Optional parameter found but has wrong type", current_path_);
+                      warnAt("Optional parameter found but has wrong type", frame);
                   }
               }
           }
+          catch (const NestingDepthError&) {
+              throw;
+          }
           catch (const std::exception& e) {
-              Logger::warn(std::format("Failed to parse optional field: {}", e.what()), 
-                  current_path_);
+              warnAt(std::format("Failed to parse optional field: {}", e.what()), frame);
           }
-          popPath();
       }
 
       template<MultipleType Field>
-      void populateMultiple(Field& field) const {
-          pushPath(field.list_key);
+      void populateMultiple(Field& field, Item list, Symbol element_symbol) const {
+          const PathFrame frame{field.list_key, parent_, depth_, offsetOf(list)};
           try {
-              auto iter = findInTree(tree_, field.list_key);
-              if (iter == tree_.end()) {
-                  popPath();
+              // The list replaces what the field held before, e.g. when a struct is populated again on reload,
+              // and a missing list leaves it empty like an empty one
+              if (list == nullptr) {
+                  field.values.clear();
                   return;
               }
 
-              if (!std::holds_alternative<std::vector<Element>>(iter->content)) {
-                  Logger::warn("Multiple field specified but actual has wrong type", current_path_);
-                  popPath();
+              if (!access_.isNested(list)) {
+                  warnAt("Multiple field specified but actual has wrong type", frame);
                   return;
               }
 
-              const auto& list = std::get<std::vector<Element>>(iter->content);
-              auto matching_elements = list | std::views::filter(
-                  [&](const auto& elem) { return elem.key == field.element_key; });
-
-              for (const auto& item : matching_elements) {
-                  pushPath(field.element_key);
+              field.values.clear();
+              access_.forEachMatching(access_.children(list), field.element_key, element_symbol, [&](Item item) {
+                  const PathFrame itemFrame{field.element_key, &frame, depth_, offsetOf(item)};
+                  bool full = false;
                   try {
-                      typename Field::value_type nestedObj;
-                      if (std::holds_alternative<std::vector<Element>>(item.content)) {
-                          populateNested(nestedObj, item);
-                          field.values.push_back(std::move(nestedObj));
+                      using ItemType = typename Field::value_type;
+                      if constexpr (StructType<ItemType>) {
+                          if (access_.isNested(item)) {
+                              ItemType nestedObj;
+                              populateNested<true>(nestedObj, item, itemFrame);
+                              full = !hasRoom(field.values);
+                              if (!full) {
+                                  field.values.push_back(std::move(nestedObj));
+                              }
+                          } else {
+                              warnAt("Invalid item structure in list", itemFrame);
+                          }
                       } else {
-                          Logger::warn("Invalid item structure in list", current_path_);
+                          if (!access_.isValue(item)) {
+                              warnAt("Invalid item structure in list", itemFrame);
+                          } else {
+                              const auto appended = appendValue(field.values, item);
+                              full = appended == Appended::full;
+                              if (appended == Appended::failed) {
+                                  warnAt(std::format("Failed to convert list item with value '{}'",
+                                      access_.value(item)), itemFrame);
+                              }
+                          }
                       }
                   }
+                  catch (const NestingDepthError&) {
+                      throw;
+                  }
                   catch (const std::exception& e) {
-                      Logger::warn(std::format("Failed to parse list item: {}", e.what()), 
-                          current_path_);
+                      warnAt(std::format("Failed to parse list item: {}", e.what()), itemFrame);
+                  }
+                  // Outside of the try, a list that does not fit fails rather than dropping the item
+                  if constexpr (FixedCapacityContainer<typename Field::container_type>) {
+                      if (full) {
+                          throw populateError(std::format("List exceeds the capacity of {} items",
+                              Field::container_type::capacity()), itemFrame);
+                      }
                   }
-                  popPath();
+              });
+          }
+          catch (const PopulateError&) {
+              throw;
+          }
+          catch (const std::exception& e) {
+              throw populateError(e.what(), frame);
+          }
+      }
+
+      template<MapType Field>
+      void populateMap(Field& field, Item list, Symbol element_symbol, Symbol key_symbol) const {
+          using KeyType = typename Field::key_type;
+          using MappedType = typename Field::mapped_type;
+          static_assert(StructType<MappedType>, "the elements of a Map are populated as structs");
+          static const Symbol attributes_symbol = SymbolTable::global().intern("<xmlattr>");
+
+          const PathFrame frame{field.list_key, parent_, depth_, offsetOf(list)};
+          try {
+              // As for Multiple, a missing list leaves the map empty
+              if (list == nullptr) {
+                  field.values.clear();
+                  return;
+              }
+
+              if (!access_.isNested(list)) {
+                  warnAt("Map field specified but actual has wrong type", frame);
+                  return;
+              }
+
+              const auto elements = access_.children(list);
+              field.values.clear();
+              if constexpr (requires { field.values.reserve(std::size_t{}); }) {
+                  std::size_t count = 0;
+                  access_.forEachMatching(elements, field.element_key, element_symbol, [&count](Item) { ++count; });
+                  field.values.reserve(count);
               }
+
+              const auto key_name = field.keyName();
+              access_.forEachMatching(elements, field.element_key, element_symbol, [&](Item item) {
+                  const PathFrame itemFrame{field.element_key, &frame, depth_, offsetOf(item)};
+                  if (!access_.isNested(item)) {
+                      warnAt("Invalid item structure in map", itemFrame);
+                      return;
+                  }
+
+                  // The key is converted from a copy, so that a moving populator does not take it from the element
+                  auto keyLevel = access_.children(item);
+                  if (field.keyIsAttribute()) {
+                      const auto position = access_.findIndex(keyLevel, "<xmlattr>", attributes_symbol);
+                      const auto attributes = position == kNotFound ? nullptr : access_.at(keyLevel, position);
+                      if (attributes == nullptr || !access_.isNested(attributes)) {
+                          warnAt(std::format("Map key '{}' not found", field.key_field), itemFrame);
+                          return;
+                      }
+                      keyLevel = access_.children(attributes);
+                  }
+                  const auto position = access_.findIndex(keyLevel, key_name, key_symbol);
+                  const auto keyItem = position == kNotFound ? nullptr : access_.at(keyLevel, position);
+                  if (keyItem == nullptr || !access_.isValue(keyItem)) {
+                      warnAt(std::format("Map key '{}' not found", field.key_field), itemFrame);
+                      return;
+                  }
+                  const auto keyValue = access_.value(keyItem);
+                  auto key = TypeConverter::tryConvert<KeyType>(keyValue);
+                  if (!key) {
+                      warnAt(std::format("Failed to convert map key with value '{}'", keyValue), itemFrame);
+                      return;
+                  }
+
+                  if (field.duplicates != DuplicateKeys::LastWins && field.values.find(*key) != field.values.end()) {
+                      if (field.duplicates == DuplicateKeys::Error) {
+                          throw populateError(std::format("Duplicate map key '{}'", keyValue), itemFrame);
+                      }
+                      return;
+                  }
+
+                  try {
+                      MappedType nestedObj;
+                      populateNested<true>(nestedObj, item, itemFrame);
+                      if (field.duplicates == DuplicateKeys::LastWins) {
+                          field.values.insert_or_assign(std::move(*key), std::move(nestedObj));
+                      } else {
+                          field.values.try_emplace(std::move(*key), std::move(nestedObj));
+                      }
+                  }
+                  catch (const NestingDepthError&) {
+                      throw;
+                  }
+                  catch (const std::exception& e) {
+                      warnAt(std::format("Failed to parse map item: {}", e.what()), itemFrame);
+                  }
+              });
+          }
+          catch (const PopulateError&) {
+              throw;
           }
           catch (const std::exception& e) {
-              throw PopulateError(e.what(), current_path_);
+              throw populateError(e.what(), frame);
           }
-          popPath();
       }
   };
+
+  using Populator = BasicPopulator<TreeAccess<false>>;
+  using MovingPopulator = BasicPopulator<TreeAccess<true>>;
 }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cpop/error.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/detail/concepts.hpp"
+#include "cpop/detail/convert.hpp"
+#include "cpop/detail/populator.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Converts or populates the item a path query found, for each of the access policies of BasicPopulator
+namespace cpop::detail {
+  template<typename T, typename Access>
+  T populateQueried(const Access& access, typename Access::Item item) {
+      const stats::Timer timer(&Stats::populate_time);
+      T obj;
+      BasicPopulator<Access>(access.children(item), nullptr, access).populate(obj);
+      return obj;
+  }
+
+  // find looks up the path and may throw for a malformed one, which like a failed population gives std::nullopt
+  template<typename T, typename Access, typename Find>
+  std::optional<T> tryQueryItem(const Access& access, Find&& find) {
+      try {
+          const auto item = std::forward<Find>(find)();
+          if (item == nullptr) {
+              return std::nullopt;
+          }
+
+          if constexpr (StructType<T>) {
+              if (!access.isNested(item)) {
+                  return std::nullopt;
+              }
+              return populateQueried<T>(access, item);
+          } else {
+              if (!access.isValue(item)) {
+                  return std::nullopt;
+              }
+              return TypeConverter::tryConvert<T>(access.value(item));
+          }
+      } catch (const PopulateError&) {
+          return std::nullopt;
+      }
+  }
+
+  template<typename T, typename Access>
+  T queryItem(const Access& access, typename Access::Item item, std::string_view path) {
+      const std::vector<std::string> errorPath{std::string(path)};
+      if (item == nullptr) {
+          throw PopulateError("Path not found", errorPath);
+      }
+
+      if constexpr (StructType<T>) {
+          if (!access.isNested(item)) {
+              throw PopulateError("Expected nested structure", errorPath, access.offset(item));
+          }
+          return populateQueried<T>(access, item);
+      } else {
+          if (!access.isValue(item)) {
+              throw PopulateError("Expected Node type", errorPath, access.offset(item));
+          }
+          return TypeConverter::convert<T>(access.value(item), errorPath, access.offset(item));
+      }
+  }
+}
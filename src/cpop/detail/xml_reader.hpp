@@ -0,0 +1,282 @@
+#pragma once
+
+#include "cpop/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpop::detail {
+  // Not constexpr on purpose: reaching it during constant evaluation turns a malformed document into a compile error
+  [[noreturn]] inline void xmlSyntaxError(std::string_view message, std::size_t offset) {
+      throw ParseError(message, offset);
+  }
+
+  // Minimal, non-validating XML reader that works both at compile time and at runtime.
+  //
+  // Reports the document to a handler with
+  //   startElement(std::string_view name, std::size_t offset)
+  //   attribute(std::string_view name, std::string value, std::size_t offset)    directly after startElement
+  //   text(std::string value)                                 entities decoded, whitespace-only text skipped
+  //   comment(std::string_view text, std::size_t offset)
+  //   endElement()
+  //
+  // offset is the byte offset of the start tag, attribute name or comment in the document.
+  //
+  // The declaration, processing instructions and a DOCTYPE without internal subset are skipped.
+  // Nesting is tracked on a heap stack rather than by recursion, so deep documents cannot overflow the call stack.
+  template<typename Handler>
+  class XmlReader {
+  public:
+      // Reads from begin to the end of xml. Offsets are always relative to the start of xml.
+      constexpr XmlReader(std::string_view xml, Handler& handler, std::size_t begin = 0)
+          : xml_(xml), handler_(handler), pos_(begin) {}
+
+      constexpr void read() {
+          while (pos_ < xml_.size()) {
+              if (startsWith("<?")) {
+                  skipPast("?>", "unterminated processing instruction");
+              } else if (startsWith("<!--")) {
+                  const auto offset = pos_;
+                  const auto start = pos_ + 4;
+                  skipPast("-->", "unterminated comment");
+                  handler_.comment(xml_.substr(start, pos_ - 3 - start), offset);
+              } else if (startsWith("<![CDATA[")) {
+                  const auto start = pos_ + 9;
+                  skipPast("]]>", "unterminated CDATA section");
+                  requireOpen(start);
+                  handler_.text(std::string(xml_.substr(start, pos_ - 3 - start)));
+              } else if (startsWith("<!DOCTYPE")) {
+                  readDoctype();
+              } else if (startsWith("</")) {
+                  readEndTag();
+              } else if (xml_[pos_] == '<') {
+                  readStartTag();
+              } else {
+                  readText();
+              }
+          }
+
+          if (!open_.empty()) {
+              xmlSyntaxError("unclosed element", pos_);
+          }
+      }
+
+  private:
+      std::string_view xml_;
+      Handler& handler_;
+      std::size_t pos_;
+      std::vector<std::string_view> open_;
+
+      static constexpr bool isSpace(char c) {
+          return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+      }
+
+      static constexpr bool isNameChar(char c) {
+          return !isSpace(c) && c != '<' && c != '>' && c != '/' && c != '=' && c != '"' && c != '\'';
+      }
+
+      constexpr bool startsWith(std::string_view prefix) const {
+          return xml_.substr(pos_).starts_with(prefix);
+      }
+
+      constexpr void skipSpace() {
+          while (pos_ < xml_.size() && isSpace(xml_[pos_])) {
+              ++pos_;
+          }
+      }
+
+      constexpr void skipPast(std::string_view terminator, std::string_view error) {
+          const auto end = xml_.find(terminator, pos_);
+          if (end == std::string_view::npos) {
+              xmlSyntaxError(error, pos_);
+          }
+          pos_ = end + terminator.size();
+      }
+
+      constexpr void expect(char c, std::string_view error) {
+          if (pos_ >= xml_.size() || xml_[pos_] != c) {
+              xmlSyntaxError(error, pos_);
+          }
+          ++pos_;
+      }
+
+      constexpr void requireOpen(std::size_t offset) const {
+          if (open_.empty()) {
+              xmlSyntaxError("text outside of the top level element", offset);
+          }
+      }
+
+      constexpr std::string_view readName() {
+          const auto start = pos_;
+          while (pos_ < xml_.size() && isNameChar(xml_[pos_])) {
+              ++pos_;
+          }
+          if (pos_ == start) {
+              xmlSyntaxError("expected a name", pos_);
+          }
+          return xml_.substr(start, pos_ - start);
+      }
+
+      constexpr void readDoctype() {
+          const auto end = xml_.find_first_of("[>", pos_);
+          if (end == std::string_view::npos || xml_[end] == '[') {
+              xmlSyntaxError("unsupported or unterminated DOCTYPE", pos_);
+          }
+          pos_ = end + 1;
+      }
+
+      constexpr void readStartTag() {
+          const auto offset = pos_++;
+          const auto name = readName();
+          handler_.startElement(name, offset);
+
+          while (true) {
+              skipSpace();
+              if (startsWith("/>")) {
+                  pos_ += 2;
+                  handler_.endElement();
+                  return;
+              }
+              if (pos_ < xml_.size() && xml_[pos_] == '>') {
+                  ++pos_;
+                  open_.push_back(name);
+                  return;
+              }
+
+              const auto attribute_offset = pos_;
+              const auto attribute = readName();
+              skipSpace();
+              expect('=', "expected '=' after attribute name");
+              skipSpace();
+              if (pos_ >= xml_.size() || (xml_[pos_] != '"' && xml_[pos_] != '\'')) {
+                  xmlSyntaxError("expected a quoted attribute value", pos_);
+              }
+              const char quote = xml_[pos_++];
+              const auto end = xml_.find(quote, pos_);
+              if (end == std::string_view::npos) {
+                  xmlSyntaxError("unterminated attribute value", pos_);
+              }
+              handler_.attribute(attribute, decode(xml_.substr(pos_, end - pos_), pos_), attribute_offset);
+              pos_ = end + 1;
+          }
+      }
+
+      constexpr void readEndTag() {
+          const auto start = pos_;
+          pos_ += 2;
+          const auto name = readName();
+          skipSpace();
+          expect('>', "expected '>' to close the end tag");
+          if (open_.empty() || open_.back() != name) {
+              xmlSyntaxError("mismatched end tag", start);
+          }
+          open_.pop_back();
+          handler_.endElement();
+      }
+
+      constexpr void readText() {
+          const auto start = pos_;
+          const auto end = xml_.find('<', pos_);
+          pos_ = end == std::string_view::npos ? xml_.size() : end;
+
+          const auto raw = xml_.substr(start, pos_ - start);
+          bool blank = true;
+          for (const char c : raw) {
+              blank = blank && isSpace(c);
+          }
+          if (blank) {
+              return;
+          }
+          requireOpen(start);
+          handler_.text(decode(raw, start));
+      }
+
+      // Replaces the predefined entities and character references
+      static constexpr std::string decode(std::string_view raw, std::size_t offset) {
+          std::string result;
+          result.reserve(raw.size());
+          for (std::size_t i = 0; i < raw.size(); ++i) {
+              if (raw[i] != '&') {
+                  result.push_back(raw[i]);
+                  continue;
+              }
+
+              const auto end = raw.find(';', i);
+              if (end == std::string_view::npos) {
+                  xmlSyntaxError("unterminated entity", offset + i);
+              }
+              const auto entity = raw.substr(i + 1, end - i - 1);
+              if (entity == "lt") { result.push_back('<'); }
+              else if (entity == "gt") { result.push_back('>'); }
+              else if (entity == "amp") { result.push_back('&'); }
+              else if (entity == "quot") { result.push_back('"'); }
+              else if (entity == "apos") { result.push_back('\''); }
+              else if (entity.starts_with('#')) { appendUtf8(result, characterReference(entity, offset + i)); }
+              else { xmlSyntaxError("unknown entity", offset + i); }
+              i = end;
+          }
+          return result;
+      }
+
+      static constexpr std::uint32_t characterReference(std::string_view entity, std::size_t offset) {
+          const bool hex = entity.starts_with("#x");
+          const auto digits = entity.substr(hex ? 2 : 1);
+          if (digits.empty()) {
+              xmlSyntaxError("invalid character reference", offset);
+          }
+
+          std::uint32_t code = 0;
+          for (const char c : digits) {
+              std::uint32_t digit = 0;
+              if (c >= '0' && c <= '9') {
+                  digit = static_cast<std::uint32_t>(c - '0');
+              } else if (hex && c >= 'a' && c <= 'f') {
+                  digit = static_cast<std::uint32_t>(c - 'a' + 10);
+              } else if (hex && c >= 'A' && c <= 'F') {
+                  digit = static_cast<std::uint32_t>(c - 'A' + 10);
+              } else {
+                  xmlSyntaxError("invalid character reference", offset);
+              }
+              code = code * (hex ? 16U : 10U) + digit;
+              if (code > 0x10FFFF) {
+                  xmlSyntaxError("character reference out of range", offset);
+              }
+          }
+          return code;
+      }
+
+      static constexpr void appendUtf8(std::string& out, std::uint32_t code) {
+          const auto byte = [](std::uint32_t bits) { return static_cast<char>(static_cast<unsigned char>(bits)); };
+          if (code < 0x80) {
+              out.push_back(byte(code));
+          } else if (code < 0x800) {
+              out.push_back(byte(0xC0 | (code >> 6)));
+              out.push_back(byte(0x80 | (code & 0x3F)));
+          } else if (code < 0x10000) {
+              out.push_back(byte(0xE0 | (code >> 12)));
+              out.push_back(byte(0x80 | ((code >> 6) & 0x3F)));
+              out.push_back(byte(0x80 | (code & 0x3F)));
+          } else {
+              out.push_back(byte(0xF0 | (code >> 18)));
+              out.push_back(byte(0x80 | ((code >> 12) & 0x3F)));
+              out.push_back(byte(0x80 | ((code >> 6) & 0x3F)));
+              out.push_back(byte(0x80 | (code & 0x3F)));
+          }
+      }
+  };
+
+  template<typename Handler>
+  constexpr void readXml(std::string_view xml, Handler& handler) {
+      XmlReader<Handler>(xml, handler).read();
+  }
+
+  // Reads the part [begin, end) of a document as if it were a document of its own, e.g. a run of sibling elements.
+  // Offsets stay relative to the whole document.
+  template<typename Handler>
+  constexpr void readXml(std::string_view xml, std::size_t begin, std::size_t end, Handler& handler) {
+      XmlReader<Handler>(xml.substr(0, end), handler, begin).read();
+  }
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cpop::detail {
+  // Where to cut a document to parse the children of one element in parallel
+  struct XmlSplit {
+      std::size_t content_begin = 0;       // content of the split element, between its start and end tag
+      std::size_t content_end = 0;
+      std::vector<std::size_t> boundaries; // starts of the chunks of the content, the first one is content_begin
+  };
+
+  // Pre-scans a document for the boundaries between the children of one element, without decoding or building anything.
+  //
+  // The split element is the root element, or the element reached from it through the first child with each key of path.
+  // The scan only tracks tags and nesting, so it does not validate; parsing the chunks does. A document that cannot be
+  // split like this, e.g. because the split element is missing or has text or CDATA of its own, gives std::nullopt.
+  // Text and CDATA inside its children do not matter, the chunks hold whole children.
+  class XmlSplitter {
+  public:
+      XmlSplitter(std::string_view xml, std::span<const std::string> path, std::size_t chunk_bytes)
+          : xml_(xml), path_(path), chunk_bytes_(chunk_bytes) {}
+
+      std::optional<XmlSplit> split() {
+          if (!findSplitElement()) {
+              return std::nullopt;
+          }
+
+          XmlSplit result{.content_begin = pos_, .content_end = 0, .boundaries = {pos_}};
+          std::size_t depth = 0;
+          while (true) {
+              const auto token = next();
+              if (token.kind == Kind::Invalid || token.kind == Kind::End) {
+                  return std::nullopt;
+              }
+              if (depth == 0) {
+                  if (token.kind == Kind::Close) {
+                      result.content_end = token.start;
+                      return result;
+                  }
+                  if (token.kind == Kind::CData || (token.kind == Kind::Text && !blank(token.start))) {
+                      return std::nullopt;
+                  }
+                  if (token.kind == Kind::Text) {
+                      continue;
+                  }
+                  // Every child starts at depth 0, so the document can be cut in front of it
+                  if (token.start - result.boundaries.back() >= chunk_bytes_) {
+                      result.boundaries.push_back(token.start);
+                  }
+              }
+
+              if (token.kind == Kind::Open) {
+                  ++depth;
+              } else if (token.kind == Kind::Close) {
+                  --depth;
+              }
+          }
+      }
+
+  private:
+      enum class Kind { Text, Open, SelfClosing, Close, Other, CData, End, Invalid };
+
+      struct Token {
+          Kind kind;
+          std::size_t start;
+          std::string_view name; // of Open, SelfClosing and Close
+      };
+
+      std::string_view xml_;
+      std::span<const std::string> path_;
+      std::size_t chunk_bytes_;
+      std::size_t pos_ = 0;
+
+      // Moves behind the start tag of the split element
+      bool findSplitElement() {
+          std::size_t depth = 0;   // open elements
+          std::size_t matched = 0; // open elements on the way to the split element, always the outermost ones
+          while (true) {
+              const auto token = next();
+              if (token.kind == Kind::Invalid || token.kind == Kind::End) {
+                  return false;
+              }
+
+              const bool on_path = depth == matched && (matched == 0 || token.name == path_[matched - 1]);
+              if (token.kind == Kind::Open) {
+                  ++depth;
+                  if (on_path && ++matched == path_.size() + 1) {
+                      return true;
+                  }
+              } else if (token.kind == Kind::SelfClosing && on_path) {
+                  return false; // the first element with the key has no children
+              } else if (token.kind == Kind::Close) {
+                  if (depth == matched) {
+                      return false; // left an element on the path without finding the next key
+                  }
+                  --depth;
+              }
+          }
+      }
+
+      bool blank(std::size_t start) const {
+          return xml_.substr(start, pos_ - start).find_first_not_of(" \t\r\n") == std::string_view::npos;
+      }
+
+      bool skipPast(std::string_view terminator) {
+          const auto end = xml_.find(terminator, pos_);
+          if (end == std::string_view::npos) {
+              return false;
+          }
+          pos_ = end + terminator.size();
+          return true;
+      }
+
+      std::string_view readName() {
+          const auto start = pos_;
+          const auto end = xml_.find_first_of(" \t\r\n/>", pos_);
+          pos_ = end == std::string_view::npos ? xml_.size() : end;
+          return xml_.substr(start, pos_ - start);
+      }
+
+      // Skips to behind the '>' of a tag, stepping over quoted attribute values. Returns whether the tag was self closing.
+      std::optional<bool> skipTag() {
+          while (pos_ < xml_.size()) {
+              const char c = xml_[pos_];
+              if (c == '"' || c == '\'') {
+                  const auto end = xml_.find(c, pos_ + 1);
+                  if (end == std::string_view::npos) {
+                      return std::nullopt;
+                  }
+                  pos_ = end + 1;
+              } else if (c == '>') {
+                  ++pos_;
+                  return xml_[pos_ - 2] == '/';
+              } else {
+                  ++pos_;
+              }
+          }
+          return std::nullopt;
+      }
+
+      Token next() {
+          const auto start = pos_;
+          if (pos_ >= xml_.size()) {
+              return {.kind = Kind::End, .start = start, .name = {}};
+          }
+
+          const auto rest = xml_.substr(pos_);
+          if (rest[0] != '<') {
+              const auto end = xml_.find('<', pos_);
+              pos_ = end == std::string_view::npos ? xml_.size() : end;
+              return {.kind = Kind::Text, .start = start, .name = {}};
+          }
+
+          bool ok = true;
+          Kind kind = Kind::Other;
+          std::string_view name;
+          if (rest.starts_with("<!--")) {
+              ok = skipPast("-->");
+          } else if (rest.starts_with("<![CDATA[")) {
+              ok = skipPast("]]>");
+              kind = Kind::CData;
+          } else if (rest.starts_with("<?")) {
+              ok = skipPast("?>");
+          } else if (rest.starts_with("<!")) {
+              ok = skipPast(">");
+          } else if (rest.starts_with("</")) {
+              pos_ += 2;
+              name = readName();
+              ok = skipPast(">");
+              kind = Kind::Close;
+          } else {
+              pos_ += 1;
+              name = readName();
+              const auto self_closing = skipTag();
+              ok = self_closing.has_value();
+              kind = self_closing.value_or(false) ? Kind::SelfClosing : Kind::Open;
+          }
+          return {.kind = ok ? kind : Kind::Invalid, .start = start, .name = name};
+      }
+  };
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "cpop/location.hpp"
 #include "cpop/detail/to_string_with_delims.hpp"
 
+#include <cstddef>
 #include <format>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -10,10 +13,12 @@
 
 namespace cpop {
 
+// offset is the byte offset in the source document of the element at path, or of the closest enclosing
+// element with a known offset, or kNoOffset
 class PopulateError : public std::runtime_error {
 public:
-    PopulateError(std::string_view message, std::vector<std::string> path)
-        : std::runtime_error(buildMessage(message, path)), path_(std::move(path)) {}
+    PopulateError(std::string_view message, std::vector<std::string> path, std::size_t offset = kNoOffset)
+        : std::runtime_error(buildMessage(message, path, offset)), path_(std::move(path)), offset_(offset) {}
 
     [[nodiscard]] const std::vector<std::string>& path() const & noexcept { 
       return path_; 
@@ -23,12 +28,51 @@ public:
       return std::move(path_); 
     }
 
+    [[nodiscard]] std::size_t offset() const noexcept {
+      return offset_;
+    }
+
+    // Line and column in source, the document the populated tree was parsed from
+    [[nodiscard]] std::optional<SourceLocation> location(std::string_view source) const {
+      return locate(source, offset_);
+    }
+
 private:
     std::vector<std::string> path_;
+    std::size_t offset_;
+
+    static std::string buildMessage(std::string_view message, const std::vector<std::string>& path, std::size_t offset) {
+        if (offset == kNoOffset) {
+            return std::format("Error at path: {}\nDetails: {}", detail::toStringWithDelims(path, " -> "), message);
+        }
+        return std::format("Error at path: {} (offset {})\nDetails: {}",
+            detail::toStringWithDelims(path, " -> "), offset, message);
+    }
+};
+
+// Nesting deeper than the populate depth limit (CPOP_MAX_POPULATE_DEPTH). Unlike other errors below optional
+// fields and list items it is never turned into a warning, so a deep document is not silently cut off.
+class NestingDepthError : public PopulateError {
+public:
+    using PopulateError::PopulateError;
+};
+
+// Malformed document, with the byte offset into the source where reading stopped
+class ParseError : public std::runtime_error {
+public:
+    ParseError(std::string_view message, std::size_t offset)
+        : std::runtime_error(std::format("Parse error at offset {}: {}", offset, message)), offset_(offset) {}
 
-    static std::string buildMessage(std::string_view message, const std::vector<std::string>& path) {
-        return std::format("Error at path: {}\nDetails: {}", detail::toStringWithDelims(path, " -> "), message);
+    [[nodiscard]] std::size_t offset() const noexcept {
+      return offset_;
     }
+
+    [[nodiscard]] std::optional<SourceLocation> location(std::string_view source) const {
+      return locate(source, offset_);
+    }
+
+private:
+    std::size_t offset_;
 };
 
 }
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "cpop/converter.hpp"
+
+#include <array>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Output types with capacity fixed at compile time, for populating without heap allocation:
+//
+//   struct Config {
+//       cpop::Param<cpop::FixedString<64>> host{"host"};
+//       cpop::Multiple<int, cpop::InplaceVector<int, 8>> ports{"ports", "port"};
+//   };
+//
+// A value or list that does not fit is reported as a PopulateError.
+namespace cpop
+{
+
+template<std::size_t N>
+class FixedString {
+public:
+    constexpr FixedString() = default;
+
+    // Throws std::length_error if value does not fit
+    constexpr explicit FixedString(std::string_view value) {
+        if (value.size() > N) {
+            throw std::length_error("FixedString capacity exceeded");
+        }
+        value.copy(data_.data(), value.size());
+        size_ = value.size();
+    }
+
+    static constexpr std::size_t capacity() { return N; }
+    [[nodiscard]] constexpr std::size_t size() const { return size_; }
+    [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+    [[nodiscard]] constexpr const char* data() const { return data_.data(); }
+    [[nodiscard]] constexpr const char* c_str() const { return data_.data(); }
+    [[nodiscard]] constexpr std::string_view view() const { return {data_.data(), size_}; }
+    constexpr operator std::string_view() const { return view(); } // NOLINT(google-explicit-constructor)
+
+    friend constexpr bool operator==(const FixedString& lhs, const FixedString& rhs) { return lhs.view() == rhs.view(); }
+    friend constexpr bool operator==(const FixedString& lhs, std::string_view rhs) { return lhs.view() == rhs; }
+
+private:
+    std::array<char, N + 1> data_{}; // null terminated
+    std::size_t size_ = 0;
+};
+
+template<std::size_t N>
+struct Converter<FixedString<N>> {
+    static std::optional<FixedString<N>> fromString(std::string_view value) {
+        if (value.size() > N) {
+            return std::nullopt;
+        }
+        return FixedString<N>(value);
+    }
+
+    static std::string describeFailure(std::string_view value) {
+        return std::format("Value of length {} exceeds the capacity of {} characters", value.size(), N);
+    }
+};
+
+// Vector with inline storage for up to N elements, like std::inplace_vector
+template<typename T, std::size_t N>
+class InplaceVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    InplaceVector() = default;
+
+    InplaceVector(const InplaceVector& other) {
+        for (const auto& value : other) {
+            push_back(value);
+        }
+    }
+
+    InplaceVector(InplaceVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        for (auto& value : other) {
+            push_back(std::move(value));
+        }
+    }
+
+    InplaceVector& operator=(const InplaceVector& other) {
+        if (this != &other) {
+            clear();
+            for (const auto& value : other) {
+                push_back(value);
+            }
+        }
+        return *this;
+    }
+
+    InplaceVector& operator=(InplaceVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            clear();
+            for (auto& value : other) {
+                push_back(std::move(value));
+            }
+        }
+        return *this;
+    }
+
+    ~InplaceVector() { clear(); }
+
+    static constexpr std::size_t capacity() { return N; }
+    [[nodiscard]] std::size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+    // Throws std::length_error when full
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ == N) {
+            throw std::length_error("InplaceVector capacity exceeded");
+        }
+        T* value = std::construct_at(slot(size_), std::forward<Args>(args)...);
+        ++size_;
+        return *value;
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    void clear() {
+        std::destroy(begin(), end());
+        size_ = 0;
+    }
+
+    T& operator[](std::size_t index) { return begin()[index]; }
+    const T& operator[](std::size_t index) const { return begin()[index]; }
+    T& front() { return *begin(); }
+    const T& front() const { return *begin(); }
+    T& back() { return end()[-1]; }
+    const T& back() const { return end()[-1]; }
+
+    T* data() { return std::launder(reinterpret_cast<T*>(storage_.data())); } // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    const T* data() const { return std::launder(reinterpret_cast<const T*>(storage_.data())); } // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    iterator begin() { return data(); }
+    iterator end() { return data() + size_; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size_; }
+
+private:
+    alignas(T) std::array<std::byte, sizeof(T) * N> storage_;
+    std::size_t size_ = 0;
+
+    T* slot(std::size_t index) {
+        return reinterpret_cast<T*>(storage_.data()) + index; // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+};
+
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "cpop/error.hpp"
+#include "cpop/location.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/concepts.hpp"
+#include "cpop/detail/convert.hpp"
+#include "cpop/detail/path.hpp"
+#include "cpop/detail/populator.hpp"
+#include "cpop/detail/query.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Trees flattened into one contiguous, position independent image: a header followed by arrays of nodes and keys
+// and the characters of all keys and values, linked by indices and offsets instead of pointers.
+//
+// An image can be placed in memory shared between processes or mapped from a file, and be populated from or queried
+// in place, without being copied into a Tree (see cpop/shm_tree.hpp):
+//
+//   auto image = cpop::flattenTree(tree);
+//   const cpop::FlatTree flat(image);
+//   cpop::populateFromTree(config, flat, "config");
+namespace cpop
+{
+
+namespace detail {
+  inline constexpr std::uint64_t kFlatMagic = 0x31'45'45'52'54'50'4f'43; // "COPTREE1"
+
+  struct FlatHeader {
+      std::uint64_t magic;
+      std::uint64_t generation; // set by whoever publishes the image, e.g. ShmPublisher
+      std::uint64_t size;       // of the whole image in bytes
+      std::uint64_t root_count; // the roots are the first nodes
+      std::uint64_t node_count;
+      std::uint64_t nodes;      // byte offset of the node array
+      std::uint64_t key_count;
+      std::uint64_t keys;       // byte offset of the key array
+      std::uint64_t strings;    // byte offset of the characters of all keys and values
+      std::uint64_t string_size;
+  };
+
+  // Distinct keys are stored once, nodes refer to them by index
+  struct FlatKey {
+      std::uint64_t offset; // into the strings
+      std::uint64_t size;
+  };
+
+  // The children of a node are stored next to each other, so every level of the tree is a range of nodes
+  struct FlatNode {
+      std::uint64_t key;    // index into the key array
+      std::uint64_t nested; // 1 if the node has children, 0 if it holds a value
+      std::uint64_t first;  // index of the first child, or offset of the value in the strings
+      std::uint64_t size;   // number of children, or length of the value
+      std::uint64_t offset; // in the source document, or kNoOffset
+  };
+
+  inline constexpr std::size_t alignFlat(std::size_t offset) {
+      return (offset + alignof(std::uint64_t) - 1) / alignof(std::uint64_t) * alignof(std::uint64_t);
+  }
+}
+
+// Builds the image of tree. Nodes are laid out breadth first, which places the children of every node together.
+inline std::vector<std::byte> flattenTree(const Tree& tree, std::uint64_t generation = 0) {
+    std::vector<detail::FlatNode> nodes;
+    std::vector<detail::FlatKey> keys;
+    std::string strings;
+    std::unordered_map<std::string_view, std::uint64_t> key_index;
+
+    const auto addNode = [&](const Element& elem) {
+        auto [iter, inserted] = key_index.try_emplace(elem.key, keys.size());
+        if (inserted) {
+            keys.push_back({.offset = strings.size(), .size = elem.key.size()});
+            strings += elem.key;
+        }
+        nodes.push_back({.key = iter->second, .nested = 0, .first = 0, .size = 0, .offset = elem.offset.get()});
+    };
+
+    std::vector<const Element*> order; // element of each node
+    for (const auto& elem : tree) {
+        addNode(elem);
+        order.push_back(&elem);
+    }
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (const auto* children = std::get_if<std::vector<Element>>(&order[i]->content)) {
+            nodes[i].nested = 1;
+            nodes[i].first = nodes.size();
+            nodes[i].size = children->size();
+            for (const auto& child : *children) {
+                addNode(child);
+                order.push_back(&child);
+            }
+        } else {
+            const auto& value = std::get<Node>(order[i]->content).value;
+            nodes[i].first = strings.size();
+            nodes[i].size = value.size();
+            strings += value;
+        }
+    }
+
+    detail::FlatHeader header{
+        .magic = detail::kFlatMagic,
+        .generation = generation,
+        .size = 0,
+        .root_count = tree.size(),
+        .node_count = nodes.size(),
+        .nodes = detail::alignFlat(sizeof(detail::FlatHeader)),
+        .key_count = keys.size(),
+        .keys = 0,
+        .strings = 0,
+        .string_size = strings.size(),
+    };
+    header.keys = detail::alignFlat(header.nodes + nodes.size() * sizeof(detail::FlatNode));
+    header.strings = header.keys + keys.size() * sizeof(detail::FlatKey);
+    header.size = header.strings + strings.size();
+
+    std::vector<std::byte> image(header.size);
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + header.nodes, nodes.data(), nodes.size() * sizeof(detail::FlatNode));
+    std::memcpy(image.data() + header.keys, keys.data(), keys.size() * sizeof(detail::FlatKey));
+    std::memcpy(image.data() + header.strings, strings.data(), strings.size());
+    return image;
+}
+
+class FlatTree;
+
+// A range of sibling nodes
+struct FlatLevel {
+    const FlatTree* tree = nullptr;
+    std::uint64_t first = 0;
+    std::uint64_t size = 0;
+};
+
+// Read only view of an image built by flattenTree. The image must be aligned to 8 bytes
+// and stay valid and unchanged for the lifetime of the view.
+//
+// Keys are interned into SymbolTable::global() of this process when the view is created, so lookups compare symbols.
+// The image is validated up front, a malformed image throws ParseError.
+class FlatTree {
+public:
+    explicit FlatTree(std::span<const std::byte> image) {
+        if (image.size() < sizeof(detail::FlatHeader)) {
+            invalid("image smaller than its header");
+        }
+        header_ = reinterpret_cast<const detail::FlatHeader*>(image.data()); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (header_->magic != detail::kFlatMagic) {
+            invalid("not a flattened tree");
+        }
+        if (header_->size > image.size()
+            || !fits(header_->nodes, header_->node_count, sizeof(detail::FlatNode))
+            || !fits(header_->keys, header_->key_count, sizeof(detail::FlatKey))
+            || !fits(header_->strings, header_->string_size, 1)
+            || header_->root_count > header_->node_count) {
+            invalid("sections out of bounds");
+        }
+
+        nodes_ = reinterpret_cast<const detail::FlatNode*>(image.data() + header_->nodes); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        keys_ = reinterpret_cast<const detail::FlatKey*>(image.data() + header_->keys); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        strings_ = reinterpret_cast<const char*>(image.data() + header_->strings); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+
+        auto& symbols = SymbolTable::global();
+        symbols_.reserve(header_->key_count);
+        for (std::uint64_t i = 0; i < header_->key_count; ++i) {
+            if (!inStrings(keys_[i].offset, keys_[i].size)) {
+                invalid("key out of bounds");
+            }
+            symbols_.push_back(symbols.intern(key(i)));
+        }
+        for (std::uint64_t i = 0; i < header_->node_count; ++i) {
+            const auto& node = nodes_[i];
+            const bool valid = node.key < header_->key_count && (node.nested != 0
+                ? node.first <= header_->node_count && node.size <= header_->node_count - node.first
+                : inStrings(node.first, node.size));
+            if (!valid) {
+                invalid("node out of bounds");
+            }
+        }
+    }
+
+    [[nodiscard]] std::uint64_t generation() const { return header_->generation; }
+    [[nodiscard]] std::size_t size() const { return header_->node_count; }
+
+    [[nodiscard]] FlatLevel roots() const { return {.tree = this, .first = 0, .size = header_->root_count}; }
+    [[nodiscard]] FlatLevel children(const detail::FlatNode& node) const {
+        return {.tree = this, .first = node.nested != 0 ? node.first : 0, .size = node.nested != 0 ? node.size : 0};
+    }
+
+    [[nodiscard]] const detail::FlatNode& node(std::uint64_t index) const { return nodes_[index]; }
+    [[nodiscard]] std::string_view key(const detail::FlatNode& node) const { return key(node.key); }
+    [[nodiscard]] Symbol symbol(const detail::FlatNode& node) const { return symbols_[node.key]; }
+    [[nodiscard]] std::string_view value(const detail::FlatNode& node) const {
+        return node.nested != 0 ? std::string_view{} : std::string_view(strings_ + node.first, node.size);
+    }
+
+    // Node at a path like "config/db_list/database[3]/port" (see cpop/query.hpp), or nullptr
+    [[nodiscard]] const detail::FlatNode* find(std::string_view path) const {
+        detail::PathReader reader(path);
+        FlatLevel level = roots();
+        const detail::FlatNode* found = nullptr;
+
+        while (auto segment = reader.next()) {
+            found = nullptr;
+            std::size_t seen = 0;
+            for (std::uint64_t i = 0; i < level.size; ++i) {
+                const auto& candidate = nodes_[level.first + i];
+                if (key(candidate) == segment->key && seen++ == segment->index) {
+                    found = &candidate;
+                    break;
+                }
+            }
+
+            if (found == nullptr) {
+                return nullptr;
+            }
+            level = children(*found);
+        }
+        return found;
+    }
+
+private:
+    const detail::FlatHeader* header_ = nullptr;
+    const detail::FlatNode* nodes_ = nullptr;
+    const detail::FlatKey* keys_ = nullptr;
+    const char* strings_ = nullptr;
+    std::vector<Symbol> symbols_; // of each key, in this process
+
+    std::string_view key(std::uint64_t index) const {
+        return {strings_ + keys_[index].offset, keys_[index].size};
+    }
+
+    bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t element_size) const {
+        return offset % alignof(std::uint64_t) == 0 && offset <= header_->size
+            && count <= (header_->size - offset) / element_size;
+    }
+
+    bool inStrings(std::uint64_t offset, std::uint64_t size) const {
+        return offset <= header_->string_size && size <= header_->string_size - offset;
+    }
+
+    [[noreturn]] static void invalid(std::string_view reason) {
+        throw ParseError(std::string("invalid flat tree: ") + std::string(reason), 0);
+    }
+};
+
+namespace detail {
+  // How BasicPopulator reads a FlatTree, see TreeAccess
+  struct FlatAccess {
+      using Level = FlatLevel;
+      using Item = const FlatNode*;
+
+      static constexpr bool kMovesStrings = false;
+
+      const FlatTree* tree = nullptr;
+
+      static std::size_t findIndex(Level level, std::string_view /*key*/, Symbol symbol) {
+          for (std::uint64_t i = 0; i < level.size; ++i) {
+              if (symbolAt(level, i) == symbol) {
+                  stats::add(&Stats::lookup_comparisons, i + 1);
+                  return i;
+              }
+          }
+          stats::add(&Stats::lookup_comparisons, level.size);
+          return kNotFound;
+      }
+
+      static std::size_t size(Level level) { return level.size; }
+      static Symbol symbolAt(Level level, std::size_t index) { return level.tree->symbol(level.tree->node(level.first + index)); }
+      static Item at(Level level, std::size_t index) { return &level.tree->node(level.first + index); }
+
+      template<typename Visit>
+      static void forEachMatching(Level level, std::string_view /*key*/, Symbol symbol, Visit&& visit) {
+          stats::add(&Stats::lookup_comparisons, level.size);
+          for (std::uint64_t i = 0; i < level.size; ++i) {
+              if (symbolAt(level, i) == symbol) {
+                  visit(at(level, i));
+              }
+          }
+      }
+
+      static bool isNested(Item item) { return item->nested != 0; }
+      static bool isValue(Item item) { return item->nested == 0; }
+      [[nodiscard]] Level children(Item item) const { return tree->children(*item); }
+      [[nodiscard]] std::string_view value(Item item) const { return tree->value(*item); }
+      static std::size_t offset(Item item) { return item->offset; }
+
+      template<typename ValueType>
+      std::optional<ValueType> tryTakeValue(Item item) const {
+          return TypeConverter::tryConvert<ValueType>(value(item));
+      }
+
+      template<typename ValueType, typename Populate>
+      static void populateNested(ValueType& value, Item /*item*/, Populate&& populate) {
+          std::forward<Populate>(populate)(value);
+      }
+  };
+}
+
+// Populates from a flat tree in place, like from the Tree it was built from
+template<typename T>
+void populateFromTree(T& obj, const FlatTree& tree) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::FlatAccess>(tree.roots(), nullptr, {&tree}).populate(obj);
+}
+
+template<typename T>
+void populateFromTree(T& obj, const FlatTree& tree, std::string topLevelTag) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::FlatAccess>(tree.roots(), nullptr, {&tree})
+        .populateRequired(obj, topLevelTag, SymbolTable::global().intern(topLevelTag));
+}
+
+// Path queries like those of cpop/query.hpp.
+// Returns std::nullopt if the path is malformed or does not exist, or the value cannot be converted or populated
+template<typename T>
+std::optional<T> tryQuery(const FlatTree& tree, std::string_view path) {
+    return detail::tryQueryItem<T>(detail::FlatAccess{&tree}, [&] { return tree.find(path); });
+}
+
+// Throws PopulateError if the path is malformed or does not exist, or the value cannot be converted or populated
+template<typename T>
+T query(const FlatTree& tree, std::string_view path) {
+    return detail::queryItem<T>(detail::FlatAccess{&tree}, tree.find(path), path);
+}
+
+}
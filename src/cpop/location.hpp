@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Source positions for diagnostics. Parsed elements remember only their byte offset into the document,
+// and errors carry that offset. Line and column are computed from the document only when asked for:
+//
+//   catch (const cpop::PopulateError& e) {
+//       if (auto location = e.location(xml)) { ... location->line, location->column ... }
+//   }
+//
+// Configure with -DCPOP_SOURCE_OFFSETS=OFF (defines CPOP_NO_SOURCE_OFFSETS) to not record offsets at all.
+namespace cpop
+{
+
+inline constexpr std::size_t kNoOffset = static_cast<std::size_t>(-1);
+
+// 1-based line and column, counted in bytes
+struct SourceLocation {
+    std::size_t line = 0;
+    std::size_t column = 0;
+
+    bool operator==(const SourceLocation&) const = default;
+};
+
+// Scans source up to offset, so only call it when a location is actually reported
+inline std::optional<SourceLocation> locate(std::string_view source, std::size_t offset) {
+    if (offset == kNoOffset || offset > source.size()) {
+        return std::nullopt;
+    }
+    const auto before = source.substr(0, offset);
+    const auto line_start = before.rfind('\n');
+    return SourceLocation{
+        .line = static_cast<std::size_t>(std::ranges::count(before, '\n')) + 1,
+        .column = offset - (line_start == std::string_view::npos ? 0 : line_start + 1) + 1,
+    };
+}
+
+// Byte offset of an element in the document it was parsed from, stored in 4 bytes, which fit into the padding of Element.
+// Offsets from 4 GiB on are not recorded. With CPOP_NO_SOURCE_OFFSETS it is empty and every offset reads as kNoOffset.
+class SourceOffset {
+public:
+    constexpr SourceOffset() = default;
+
+#ifdef CPOP_NO_SOURCE_OFFSETS
+    constexpr explicit SourceOffset(std::size_t /*offset*/) {}
+
+    [[nodiscard]] constexpr std::size_t get() const { return kNoOffset; }
+#else
+    constexpr explicit SourceOffset(std::size_t offset)
+        : value_(offset < kUnknown ? static_cast<std::uint32_t>(offset) : kUnknown) {}
+
+    [[nodiscard]] constexpr std::size_t get() const { return value_ == kUnknown ? kNoOffset : value_; }
+
+private:
+    static constexpr std::uint32_t kUnknown = UINT32_MAX;
+
+    std::uint32_t value_ = kUnknown;
+#endif
+};
+
+}
@@ -3,10 +3,13 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace cpop
 {
+  // Extra constructor arguments are passed on to the value, e.g. a memory resource for a std::pmr::string
   template<typename T>
   struct Param {
       std::string key;
@@ -14,6 +17,10 @@ namespace cpop
       using value_type = T;
 
       explicit Param(std::string key) : key(std::move(key)) {}
+
+      template<typename... Args>
+          requires (sizeof...(Args) > 0)
+      Param(std::string key, Args&&... args) : key(std::move(key)), value(std::forward<Args>(args)...) {}
   };
 
   template<typename T>
@@ -25,14 +32,57 @@ namespace cpop
       explicit OptParam(std::string key) : key(std::move(key)) {}
   };
 
-  template<typename T>
+  // Container may be any sequence with push_back and clear, such as a std::pmr::vector
+  // or a fixed-capacity cpop::InplaceVector. Extra constructor arguments are passed on to it.
+  template<typename T, typename Container = std::vector<T>>
   struct Multiple {
       std::string list_key;    // Key for the list container
       std::string element_key; // Key for each element
-      std::vector<T> values;
+      Container values;
       using value_type = T;
+      using container_type = Container;
 
       Multiple(std::string list_key, std::string element_key) 
           : list_key(std::move(list_key)), element_key(std::move(element_key)) {}
+
+      template<typename... Args>
+          requires (sizeof...(Args) > 0)
+      Multiple(std::string list_key, std::string element_key, Args&&... args)
+          : list_key(std::move(list_key)), element_key(std::move(element_key)), values(std::forward<Args>(args)...) {}
+  };
+
+  // What a Map does with an element whose key it already holds
+  enum class DuplicateKeys {
+      Error,     // PopulateError
+      FirstWins, // the later element is skipped
+      LastWins,  // the later element replaces the earlier one
+  };
+
+  // The elements of a list, keyed by one of their children, e.g. databases by name:
+  //
+  //   cpop::Map<std::string, Database> databases{"db_list", "database", "name"};
+  //
+  // A key starting with '@' names an attribute instead, as in "@id". The map is reserved for the number of
+  // elements and filled in one pass. Container may be any map with find, try_emplace and insert_or_assign.
+  template<typename K, typename V, typename Container = std::unordered_map<K, V>>
+  struct Map {
+      std::string list_key;    // Key for the list container
+      std::string element_key; // Key for each element
+      std::string key_field;   // Child, or '@' and attribute, of each element that holds its key
+      DuplicateKeys duplicates;
+      Container values;
+      using key_type = K;
+      using mapped_type = V;
+      using container_type = Container;
+
+      Map(std::string list_key, std::string element_key, std::string key_field,
+          DuplicateKeys duplicates = DuplicateKeys::Error)
+          : list_key(std::move(list_key)), element_key(std::move(element_key)), key_field(std::move(key_field)),
+            duplicates(duplicates) {}
+
+      [[nodiscard]] bool keyIsAttribute() const { return key_field.starts_with('@'); }
+      [[nodiscard]] std::string_view keyName() const {
+          return keyIsAttribute() ? std::string_view(key_field).substr(1) : std::string_view(key_field);
+      }
   };
 }
@@ -1,58 +1,377 @@
 #pragma once
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
+#include "cpop/error.hpp"
+#include "cpop/shared_tree.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/xml_reader.hpp"
+#include "cpop/detail/xml_split.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace cpop {
+  namespace detail {
+    // Builds a Tree from the events of XmlReader. Open elements are kept on an explicit stack,
+    // and a partially built tree is torn down with destroyTree, so nesting depth only costs heap.
+    class TreeBuilder {
+    public:
+        TreeBuilder() = default;
+        TreeBuilder(const TreeBuilder&) = delete;
+        TreeBuilder& operator=(const TreeBuilder&) = delete;
+        TreeBuilder(TreeBuilder&&) = delete;
+        TreeBuilder& operator=(TreeBuilder&&) = delete;
+        ~TreeBuilder() { destroyTree(std::move(result_)); }
+
+        Tree take() { return std::move(result_); }
+
+        void startElement(std::string_view name, std::size_t offset) {
+            closeAttributes();
+            open_.push_back({.element = &add(currentLevel(), name, offset), .text = {}, .attributes = nullptr});
+        }
+
+        void attribute(std::string_view name, std::string value, std::size_t offset) {
+            auto& top = open_.back();
+            if (top.attributes == nullptr) {
+                top.attributes = &add(std::get<std::vector<Element>>(top.element->content), "<xmlattr>", offset);
+            }
+            add(std::get<std::vector<Element>>(top.attributes->content), name, offset).content = Node{std::move(value)};
+        }
+
+        void text(std::string value) {
+            open_.back().text += value;
+        }
+
+        void comment(std::string_view text, std::size_t offset) {
+            closeAttributes();
+            add(currentLevel(), "<xmlcomment>", offset).content = Node{std::string(text)};
+        }
+
+        void endElement() {
+            auto& top = open_.back();
+            // Elements without children are leaves holding their text; text mixed with child elements is dropped
+            if (std::get<std::vector<Element>>(top.element->content).empty()) {
+                top.element->content = Node{std::move(top.text)};
+            }
+            open_.pop_back();
+        }
+
+    private:
+        // An open element stays at the same address: only its own descendants are added while it is open
+        struct Open {
+            Element* element;
+            std::string text;
+            Element* attributes; // "<xmlattr>" child while attributes are being read
+        };
+
+        Tree result_;
+        std::vector<Open> open_;
+        // Keys are views into the document, which outlives the builder. A document repeats few distinct keys,
+        // so this saves most lookups in the global table, whose lock is shared by all threads parsing at once.
+        std::unordered_map<std::string_view, Symbol> symbols_;
+
+        Tree& currentLevel() {
+            return open_.empty() ? result_ : std::get<std::vector<Element>>(open_.back().element->content);
+        }
+
+        void closeAttributes() {
+            if (!open_.empty()) {
+                open_.back().attributes = nullptr;
+            }
+        }
+
+        Element& add(Tree& level, std::string_view key, std::size_t offset) {
+            stats::add(&Stats::nodes);
+
+            auto [symbol, inserted] = symbols_.try_emplace(key, kNoSymbol);
+            if (inserted) {
+                symbol->second = SymbolTable::global().intern(key);
+            }
+
+            auto& element = level.emplace_back();
+            element.key = key;
+            element.symbol = symbol->second;
+            element.offset = SourceOffset(offset);
+            return element;
+        }
+    };
+    // Builds a SharedTree from the events of XmlReader, interning each element into the pool once it is complete
+    class SharedTreeBuilder {
+    public:
+        explicit SharedTreeBuilder(NodePool& pool) : pool_(pool) {}
+
+        SharedTree take() { return std::move(roots_); }
+
+        // Offsets are not recorded: a shared node stands for every place its subtree occurs
+        void startElement(std::string_view name, std::size_t /*offset*/) {
+            closeAttributes();
+            open_.push_back({.key = name, .text = {}, .children = {}, .attributes = {}});
+        }
+
+        void attribute(std::string_view name, std::string value, std::size_t /*offset*/) {
+            stats::add(&Stats::nodes);
+            open_.back().attributes.push_back(pool_.leaf(name, std::move(value)));
+        }
+
+        void text(std::string value) {
+            open_.back().text += value;
+        }
+
+        void comment(std::string_view text, std::size_t /*offset*/) {
+            closeAttributes();
+            stats::add(&Stats::nodes);
+            currentLevel().push_back(pool_.leaf("<xmlcomment>", std::string(text)));
+        }
+
+        void endElement() {
+            closeAttributes();
+            auto top = std::move(open_.back());
+            open_.pop_back();
+
+            stats::add(&Stats::nodes);
+            currentLevel().push_back(top.children.empty()
+                ? pool_.leaf(top.key, std::move(top.text))
+                : pool_.nested(top.key, std::move(top.children)));
+        }
+
+    private:
+        struct Open {
+            std::string_view key;
+            std::string text;
+            std::vector<SharedRef> children;
+            std::vector<SharedRef> attributes; // become the "<xmlattr>" child once the start tag is complete
+        };
+
+        NodePool& pool_;
+        SharedTree roots_;
+        std::vector<Open> open_;
+
+        SharedTree& currentLevel() {
+            return open_.empty() ? roots_ : open_.back().children;
+        }
+
+        void closeAttributes() {
+            if (!open_.empty() && !open_.back().attributes.empty()) {
+                stats::add(&Stats::nodes);
+                auto& top = open_.back();
+                top.children.push_back(pool_.nested("<xmlattr>", std::move(top.attributes)));
+                top.attributes.clear();
+            }
+        }
+    };
+  }
+
+  // How XMLParser::parseParallel splits a document
+  struct ParallelParseOptions {
+      std::size_t threads = 0;              // threads parsing at once, including the caller; 0 for one per hardware thread
+      std::vector<std::string> split_path;  // keys from the root element to the element whose children are split, empty for the root
+      std::size_t min_chunk_bytes = 256 * 1024; // smaller documents are parsed on the calling thread only
+  };
+
+  // Attributes become children of an "<xmlattr>" element and comments "<xmlcomment>" elements.
+  // Malformed documents throw ParseError.
+  //
+  // Parsing is iterative, but a returned Tree's own destructor recurses once per nesting level. Release trees of
+  // untrusted or machine generated documents, which may be nested deep enough to overflow the stack, with
+  // cpop::destroyTree, or hand them to populateFromTree as rvalues, which tears them down the same way.
   class XMLParser {
   public:
-      static cpop::Tree parse(const std::string& xml_string) {
-          boost::property_tree::ptree pt;
-          std::stringstream ss(xml_string);
-          boost::property_tree::read_xml(ss, pt);
-          
-          return parseTree(pt);
+      // See the class comment on releasing deep trees
+      static cpop::Tree parse(std::string_view xml_string) {
+          const detail::stats::Timer timer(&Stats::parse_time);
+          detail::stats::add(&Stats::bytes, xml_string.size());
+
+          return parseRange(xml_string, 0, xml_string.size());
+      }
+
+      // Parses a document whose root (or another element, see ParallelParseOptions::split_path) holds many children,
+      // such as a long list of records. A quick pre-scan cuts the children into chunks, the chunks are parsed concurrently
+      // and stitched together in document order. The result is the same as that of parse, including element offsets.
+      //
+      // A document that cannot be split is parsed like by parse. Malformed documents are parsed again on the calling
+      // thread, so ParseError reports the same first error as parse.
+      static cpop::Tree parseParallel(std::string_view xml_string, const ParallelParseOptions& options = {}) {
+          const detail::stats::Timer timer(&Stats::parse_time);
+          detail::stats::add(&Stats::bytes, xml_string.size());
+
+          const std::size_t threads = options.threads != 0 ? options.threads : std::max(1U, std::thread::hardware_concurrency());
+          // A few chunks per thread even out chunks that take longer than others
+          const std::size_t chunk_bytes = std::max(options.min_chunk_bytes, xml_string.size() / (threads * 4));
+          const auto split = threads > 1
+              ? detail::XmlSplitter(xml_string, options.split_path, chunk_bytes).split()
+              : std::nullopt;
+          if (!split || split->boundaries.size() < 2) {
+              return parseRange(xml_string, 0, xml_string.size());
+          }
+
+          try {
+              return parseSplit(xml_string, *split, options.split_path, threads);
+          } catch (const ParseError&) {
+              return parseRange(xml_string, 0, xml_string.size());
+          }
+      }
+
+      // Parses into hash-consed nodes of pool, so repeated subtrees are stored once
+      static cpop::SharedTree parseShared(std::string_view xml_string, NodePool& pool) {
+          const detail::stats::Timer timer(&Stats::parse_time);
+          detail::stats::add(&Stats::bytes, xml_string.size());
+
+          detail::SharedTreeBuilder builder(pool);
+          detail::readXml(xml_string, builder);
+          return builder.take();
       }
 
       static cpop::Tree parseFromFile(const std::string& filename) {
-          boost::property_tree::ptree pt;
-          boost::property_tree::read_xml(filename, pt);
-          
-          return parseTree(pt);
+          std::string xml_string;
+          {
+              const detail::stats::Timer timer(&Stats::read_time);
+              std::ifstream file(filename, std::ios::binary);
+              if (!file) {
+                  throw ParseError("cannot open file " + filename, 0);
+              }
+              xml_string.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+          }
+
+          return parse(xml_string);
+      }
+
+      static cpop::Tree parseFromFileParallel(const std::string& filename, const ParallelParseOptions& options = {}) {
+          std::string xml_string;
+          {
+              const detail::stats::Timer timer(&Stats::read_time);
+              std::ifstream file(filename, std::ios::binary);
+              if (!file) {
+                  throw ParseError("cannot open file " + filename, 0);
+              }
+              xml_string.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+          }
+
+          return parseParallel(xml_string, options);
       }
 
   private:
-      static cpop::Tree parseTree(const boost::property_tree::ptree& pt) {
-          Tree result;
-          
-          for (const auto& child : pt) {
-              result.push_back(parseElement(child.first, child.second));
+      static cpop::Tree parseRange(std::string_view xml_string, std::size_t begin, std::size_t end) {
+          detail::TreeBuilder builder;
+          detail::readXml(xml_string, begin, end, builder);
+          return builder.take();
+      }
+
+      static cpop::Tree parseSplit(std::string_view xml_string, const detail::XmlSplit& split,
+                                   const std::vector<std::string>& split_path, std::size_t threads) {
+          const auto chunk_count = split.boundaries.size();
+          detail::stats::add(&Stats::parallel_chunks, chunk_count);
+          std::vector<Tree> chunks(chunk_count);
+          std::vector<Stats> chunk_stats(chunk_count);
+          std::vector<std::exception_ptr> errors(chunk_count);
+          std::atomic<std::size_t> next{0};
+
+          const auto work = [&] {
+              for (auto i = next++; i < chunk_count; i = next++) {
+                  const auto end = i + 1 < chunk_count ? split.boundaries[i + 1] : split.content_end;
+                  try {
+                      const StatsScope scope(chunk_stats[i]);
+                      chunks[i] = parseRange(xml_string, split.boundaries[i], end);
+                  } catch (...) {
+                      errors[i] = std::current_exception();
+                  }
+              }
+          };
+
+          // Everything but the content of the split element, parsed while the workers parse the content
+          const auto content_size = split.content_end - split.content_begin;
+          std::string outline;
+          outline.reserve(xml_string.size() - content_size);
+          outline.append(xml_string.substr(0, split.content_begin)).append(xml_string.substr(split.content_end));
+
+          Tree tree;
+          try {
+              {
+                  std::vector<std::jthread> workers;
+                  for (std::size_t i = 1; i < std::min(threads, chunk_count); ++i) {
+                      workers.emplace_back(work);
+                  }
+                  tree = parseRange(outline, 0, outline.size());
+                  work();
+              }
+
+              for (std::size_t i = 0; i < chunk_count; ++i) {
+                  if (errors[i]) {
+                      std::rethrow_exception(errors[i]);
+                  }
+                  detail::stats::add(&Stats::nodes, chunk_stats[i].nodes);
+              }
+
+              // Elements behind the cut out content were parsed at offsets that are content_size too small
+              std::vector<Tree*> pending{&tree};
+              while (!pending.empty()) {
+                  Tree* level = pending.back();
+                  pending.pop_back();
+                  for (auto& elem : *level) {
+                      if (const auto offset = elem.offset.get(); offset != kNoOffset && offset >= split.content_begin) {
+                          elem.offset = SourceOffset(offset + content_size);
+                      }
+                      if (auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                          pending.push_back(children);
+                      }
+                  }
+              }
+
+              auto& content = splitElement(tree, split_path);
+              std::size_t total = content.size();
+              for (const auto& chunk : chunks) {
+                  total += chunk.size();
+              }
+              content.reserve(total);
+              for (auto& chunk : chunks) {
+                  std::ranges::move(chunk, std::back_inserter(content));
+                  chunk.clear();
+              }
+          } catch (...) {
+              // Chunks parsed before the error may be deep
+              for (auto& chunk : chunks) {
+                  destroyTree(std::move(chunk));
+              }
+              destroyTree(std::move(tree));
+              throw;
+          }
+          return tree;
+      }
+
+      // Children of the split element in the outline, found like XmlSplitter finds it
+      static Tree& splitElement(Tree& tree, const std::vector<std::string>& split_path) {
+          const auto first = [](Tree& level, auto matches) -> Element& {
+              auto iter = std::ranges::find_if(level, matches);
+              if (iter == level.end()) {
+                  throw ParseError("split element not found", 0);
+              }
+              return *iter;
+          };
+
+          Element* elem = &first(tree, [](const Element& e) { return e.key != "<xmlcomment>"; });
+          for (const auto& key : split_path) {
+              auto* children = std::get_if<std::vector<Element>>(&elem->content);
+              if (children == nullptr) {
+                  throw ParseError("split element not found", 0);
+              }
+              elem = &first(*children, [&key](const Element& e) { return e.key == key; });
           }
-          
-          return result;
-      }
-      
-      static cpop::Element parseElement(const std::string& key, const boost::property_tree::ptree& pt) {
-          cpop::Element element;
-          element.key = key;
-          
-          // Check if this node has children
-          if (pt.empty()) {
-              // This is a leaf node
-              cpop::Node node;
-              node.value = pt.data();
-              element.content = node;
-          } else {
-              // This is a parent node with children
-              std::vector<cpop::Element> children;
-              for (const auto& child : pt) {
-                  children.push_back(parseElement(child.first, child.second));
-              }
-              element.content = children;
+          // Without its content the split element is empty, or only holds its attributes
+          if (std::holds_alternative<Node>(elem->content)) {
+              elem->content.emplace<std::vector<Element>>();
           }
-          
-          return element;
+          return std::get<std::vector<Element>>(elem->content);
       }
   };
 }
@@ -1,52 +1,77 @@
 #pragma once
 
 #include "cpop/params.hpp"
+#include "cpop/shared_tree.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
 #include "cpop/tree.hpp"
-#include "cpop/detail/concepts.hpp"
 #include "cpop/detail/populator.hpp"
 
-#include <boost/pfr/core.hpp>
-
 #include <string>
-#include <type_traits>
 #include <utility>
 
 namespace cpop
 {
 
+// Population only reads the tree and keeps all of its state local to the call,
+// so many threads may populate (different) objects from one shared const Tree at the same time.
 template<typename T>
 void populateFromTree(T& obj, const Tree& tree) {
-    detail::Populator populator(tree);
-    boost::pfr::for_each_field(obj, [&populator](auto& field) {
-        using FieldType = std::remove_cvref_t<decltype(field)>;
-
-        if constexpr (detail::RequiredParamType<FieldType>) {
-            populator.populateRequired(field);
-        }
-        else if constexpr (detail::OptionalParamType<FieldType>) {
-            populator.populateOptional(field);
-        }
-        else if constexpr (detail::MultipleType<FieldType>) {
-            populator.populateMultiple(field);
-        }
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::Populator(&tree).populate(obj);
+}
 
-        // skip fields that are not params
-    });
+// Populates from a tree that is about to be discarded, moving string values out of it instead of copying them.
+// The tree is torn down with destroyTree afterwards, so a deep temporary does not recurse in its destructor.
+template<typename T>
+void populateFromTree(T& obj, Tree&& tree) {
+    const detail::TreeDisposer disposer(tree);
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::MovingPopulator(&tree).populate(obj);
 }
 
 // Most xml docs have an overall element at the top level.
-// This is a convenience function so that you don't have to manually create a struct for the element
+// This is a convenience function so that you don't have to manually create a struct for the element.
+// Like the overloads above, obj is populated in place from the children of that element.
 template<typename T>
 void populateFromTree(T& obj, const Tree& tree, std::string topLevelTag) {
-    struct Wrapper {
-      Param<T> config;
-    };
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::Populator(&tree).populateRequired(obj, topLevelTag, SymbolTable::global().intern(topLevelTag));
+}
+
+template<typename T>
+void populateFromTree(T& obj, Tree&& tree, std::string topLevelTag) {
+    const detail::TreeDisposer disposer(tree);
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::MovingPopulator(&tree).populateRequired(obj, topLevelTag, SymbolTable::global().intern(topLevelTag));
+}
 
-    Wrapper wrapper{.config = Param<T>{std::move(topLevelTag)}};
+// Populates from a hash-consed tree. With a cache, a nested struct is only populated once per distinct subtree
+// and copied for every further occurrence (see PopulateCache).
+template<typename T>
+void populateFromTree(T& obj, const SharedTree& tree) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::SharedAccess>(&tree).populate(obj);
+}
+
+template<typename T>
+void populateFromTree(T& obj, const SharedTree& tree, PopulateCache& cache) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::SharedAccess>(&tree, nullptr, {&cache}).populate(obj);
+}
 
-    populateFromTree(wrapper, tree);
+template<typename T>
+void populateFromTree(T& obj, const SharedTree& tree, std::string topLevelTag) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::SharedAccess>(&tree)
+        .populateRequired(obj, topLevelTag, SymbolTable::global().intern(topLevelTag));
+}
 
-    obj = wrapper.config.value;
+template<typename T>
+void populateFromTree(T& obj, const SharedTree& tree, std::string topLevelTag, PopulateCache& cache) {
+    const detail::stats::Timer timer(&Stats::populate_time);
+    detail::BasicPopulator<detail::SharedAccess>(&tree, nullptr, {&cache})
+        .populateRequired(obj, topLevelTag, SymbolTable::global().intern(topLevelTag));
 }
 
 }
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "cpop/populate.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/path.hpp"
+#include "cpop/detail/query.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Ad-hoc lookups into a Tree with paths like "db_list/database[3]/port".
+// Segments are separated by '/', and an optional zero based [n] picks the n-th sibling with that key.
+namespace cpop
+{
+
+// Reusable index over a Tree. Building it costs one pass over the tree,
+// after which each lookup costs one hash lookup per path segment instead of a scan.
+// The tree must outlive the index and must not be modified while the index is in use.
+class PathIndex {
+public:
+    explicit PathIndex(const Tree& tree) : root_(&tree) {
+        std::vector<const Tree*> pending{&tree};
+        while (!pending.empty()) {
+            const Tree* level = pending.back();
+            pending.pop_back();
+
+            auto& index = levels_[level];
+            for (const auto& elem : *level) {
+                index[elem.key].push_back(&elem);
+                if (const auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                    pending.push_back(children);
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] const Element* find(std::string_view path) const {
+        detail::PathReader reader(path);
+        const Tree* level = root_;
+        const Element* found = nullptr;
+
+        while (auto segment = reader.next()) {
+            if (level == nullptr) {
+                return nullptr;
+            }
+
+            const auto levelIter = levels_.find(level);
+            if (levelIter == levels_.end()) {
+                return nullptr;
+            }
+
+            const auto keyIter = levelIter->second.find(segment->key);
+            if (keyIter == levelIter->second.end() || segment->index >= keyIter->second.size()) {
+                return nullptr;
+            }
+
+            found = keyIter->second[segment->index];
+            level = std::get_if<std::vector<Element>>(&found->content);
+        }
+        return found;
+    }
+
+private:
+    using LevelIndex = std::unordered_map<std::string_view, std::vector<const Element*>>;
+
+    const Tree* root_;
+    std::unordered_map<const Tree*, LevelIndex> levels_;
+};
+
+// Linear lookup without an index, fine for one-off queries
+inline const Element* findPath(const Tree& tree, std::string_view path) {
+    detail::PathReader reader(path);
+    const Tree* level = &tree;
+    const Element* found = nullptr;
+
+    while (auto segment = reader.next()) {
+        if (level == nullptr) {
+            return nullptr;
+        }
+
+        found = nullptr;
+        std::size_t seen = 0;
+        for (const auto& elem : *level) {
+            if (elem.key == segment->key && seen++ == segment->index) {
+                found = &elem;
+                break;
+            }
+        }
+
+        if (found == nullptr) {
+            return nullptr;
+        }
+        level = std::get_if<std::vector<Element>>(&found->content);
+    }
+    return found;
+}
+
+// Returns std::nullopt if the path is malformed or does not exist, or the value cannot be converted or populated
+template<typename T>
+std::optional<T> tryQuery(const Tree& tree, std::string_view path) {
+    return detail::tryQueryItem<T>(detail::TreeAccess<false>{}, [&] { return findPath(tree, path); });
+}
+
+template<typename T>
+std::optional<T> tryQuery(const PathIndex& index, std::string_view path) {
+    return detail::tryQueryItem<T>(detail::TreeAccess<false>{}, [&] { return index.find(path); });
+}
+
+// Throws PopulateError if the path is malformed or does not exist, or the value cannot be converted or populated
+template<typename T>
+T query(const Tree& tree, std::string_view path) {
+    return detail::queryItem<T>(detail::TreeAccess<false>{}, findPath(tree, path), path);
+}
+
+template<typename T>
+T query(const PathIndex& index, std::string_view path) {
+    return detail::queryItem<T>(detail::TreeAccess<false>{}, index.find(path), path);
+}
+
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/convert.hpp"
+#include "cpop/detail/populator.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Hash-consed trees for documents that repeat the same blocks many times.
+//
+// A NodePool stores every structurally distinct subtree once, so memory scales with the unique content of a document.
+// Produce shared trees with XMLParser::parseShared or NodePool::intern and populate from them like from a Tree.
+// Passing a PopulateCache additionally reuses the populated struct for a subtree that was populated before.
+namespace cpop
+{
+
+struct SharedNode;
+using SharedRef = const SharedNode*;
+using SharedTree = std::vector<SharedRef>;
+
+// Immutable node owned by a NodePool. Within one pool structurally equal subtrees are the same node,
+// so equality of subtrees is pointer equality and hash is a precomputed structural hash.
+struct SharedNode {
+    std::string_view key; // name in SymbolTable::global()
+    Symbol symbol = kNoSymbol;
+    bool nested = false;
+    std::string value;
+    std::vector<SharedRef> children;
+    std::size_t hash = 0;
+};
+
+// Owns the nodes of shared trees. Nodes stay valid for the lifetime of the pool. Not thread safe.
+class NodePool {
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    NodePool(NodePool&&) = default;
+    NodePool& operator=(NodePool&&) = default;
+    ~NodePool() = default;
+
+    SharedRef leaf(std::string_view key, std::string value) {
+        SharedNode node = makeNode(key);
+        node.value = std::move(value);
+        node.hash = combine(node.symbol, std::hash<std::string>{}(node.value));
+        return intern(std::move(node));
+    }
+
+    SharedRef nested(std::string_view key, std::vector<SharedRef> children) {
+        SharedNode node = makeNode(key);
+        node.nested = true;
+        node.hash = combine(node.symbol, children.size());
+        for (const auto child : children) {
+            node.hash = combine(node.hash, child->hash);
+        }
+        node.children = std::move(children);
+        return intern(std::move(node));
+    }
+
+    // Hash-conses an existing tree, visiting it with an explicit stack
+    SharedTree intern(const Tree& tree) {
+        struct Level {
+            const Tree* elements;
+            std::size_t next;
+            std::vector<SharedRef> nodes;
+            const Element* owner;
+        };
+
+        std::vector<Level> pending;
+        pending.push_back({&tree, 0, {}, nullptr});
+        while (true) {
+            auto& level = pending.back();
+            if (level.next < level.elements->size()) {
+                const auto& elem = (*level.elements)[level.next++];
+                if (const auto* children = std::get_if<std::vector<Element>>(&elem.content)) {
+                    pending.push_back({children, 0, {}, &elem});
+                } else {
+                    level.nodes.push_back(leaf(elem.key, std::get<Node>(elem.content).value));
+                }
+                continue;
+            }
+
+            if (pending.size() == 1) {
+                return std::move(level.nodes);
+            }
+            Level done = std::move(level);
+            pending.pop_back();
+            pending.back().nodes.push_back(nested(done.owner->key, std::move(done.nodes)));
+        }
+    }
+
+    // Number of distinct nodes
+    [[nodiscard]] std::size_t size() const { return nodes_.size(); }
+
+private:
+    struct Hash {
+        std::size_t operator()(SharedRef node) const { return node->hash; }
+    };
+
+    // Children are already interned, so comparing them is comparing pointers
+    struct Equal {
+        bool operator()(SharedRef lhs, SharedRef rhs) const {
+            return lhs->symbol == rhs->symbol && lhs->nested == rhs->nested &&
+                (lhs->nested ? lhs->children == rhs->children : lhs->value == rhs->value);
+        }
+    };
+
+    std::deque<SharedNode> nodes_; // deque so that nodes never move
+    std::unordered_set<SharedRef, Hash, Equal> index_;
+
+    static SharedNode makeNode(std::string_view key) {
+        auto& symbols = SymbolTable::global();
+        SharedNode node;
+        node.symbol = symbols.intern(key);
+        node.key = symbols.name(node.symbol);
+        return node;
+    }
+
+    static std::size_t combine(std::size_t seed, std::size_t value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+
+    SharedRef intern(SharedNode&& node) {
+        if (auto iter = index_.find(&node); iter != index_.end()) {
+            return *iter;
+        }
+        const auto& stored = nodes_.emplace_back(std::move(node));
+        index_.insert(&stored);
+        return &stored;
+    }
+};
+
+// Populated structs by (type, shared node), so a subtree that occurs many times is only populated once.
+// Entries point into the pool the nodes came from and must not outlive it. Not thread safe.
+//
+// A cached result is copied as is: warnings of the first population are not repeated, and keys changed
+// on the object being populated are not taken into account for nested structs found in the cache.
+class PopulateCache {
+public:
+    template<typename T>
+    const T* find(SharedRef node) {
+        auto iter = entries_.find({&typeTag<T>, node});
+        if (iter == entries_.end()) {
+            return nullptr;
+        }
+        ++hits_;
+        return static_cast<const T*>(iter->second.get());
+    }
+
+    template<typename T>
+    void store(SharedRef node, const T& value) {
+        entries_.try_emplace({&typeTag<T>, node}, std::make_shared<const T>(value));
+    }
+
+    [[nodiscard]] std::size_t size() const { return entries_.size(); }
+    [[nodiscard]] std::size_t hits() const { return hits_; }
+
+    void clear() {
+        entries_.clear();
+        hits_ = 0;
+    }
+
+private:
+    template<typename T>
+    static constexpr char typeTag{};
+
+    struct Key {
+        const void* type;
+        SharedRef node;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            return std::hash<const void*>{}(key.type) ^ (key.node->hash << 1);
+        }
+    };
+
+    std::unordered_map<Key, std::shared_ptr<const void>, KeyHash> entries_;
+    std::size_t hits_ = 0;
+};
+
+namespace detail {
+  // How BasicPopulator reads a SharedTree, see TreeAccess
+  struct SharedAccess {
+      using Level = const SharedTree*;
+      using Item = SharedRef;
+
+      static constexpr bool kMovesStrings = false;
+
+      PopulateCache* cache = nullptr;
+
+      static std::size_t findIndex(Level level, std::string_view /*key*/, Symbol symbol) {
+          for (std::size_t i = 0; i < level->size(); ++i) {
+              if ((*level)[i]->symbol == symbol) {
+                  stats::add(&Stats::lookup_comparisons, i + 1);
+                  return i;
+              }
+          }
+          stats::add(&Stats::lookup_comparisons, level->size());
+          return kNotFound;
+      }
+
+      static std::size_t size(Level level) { return level->size(); }
+      static Symbol symbolAt(Level level, std::size_t index) { return (*level)[index]->symbol; }
+      static Item at(Level level, std::size_t index) { return (*level)[index]; }
+
+      template<typename Visit>
+      static void forEachMatching(Level level, std::string_view /*key*/, Symbol symbol, Visit&& visit) {
+          stats::add(&Stats::lookup_comparisons, level->size());
+          for (const auto node : *level) {
+              if (node->symbol == symbol) {
+                  visit(node);
+              }
+          }
+      }
+
+      static bool isNested(Item item) { return item->nested; }
+      static bool isValue(Item item) { return !item->nested; }
+      static Level children(Item item) { return &item->children; }
+      static std::string_view value(Item item) { return item->value; }
+      static std::size_t offset(Item /*item*/) { return kNoOffset; }
+
+      template<typename ValueType>
+      static std::optional<ValueType> tryTakeValue(Item item) {
+          return TypeConverter::tryConvert<ValueType>(item->value);
+      }
+
+      template<typename ValueType, typename Populate>
+      void populateNested(ValueType& value, Item item, Populate&& populate) const {
+          if (cache == nullptr) {
+              std::forward<Populate>(populate)(value);
+              return;
+          }
+          if (const auto* cached = cache->find<ValueType>(item)) {
+              value = *cached;
+              return;
+          }
+          std::forward<Populate>(populate)(value);
+          cache->store(item, value);
+      }
+  };
+}
+
+}
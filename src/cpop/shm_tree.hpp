@@ -0,0 +1,287 @@
+#pragma once
+
+#include "cpop/error.hpp"
+#include "cpop/flat_tree.hpp"
+#include "cpop/tree.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+// Configs published once per host into POSIX shared memory, for many worker processes to read in place.
+//
+// A ShmPublisher writes each version of a tree as a flat image (see cpop/flat_tree.hpp) into its own shared memory
+// object "<name>.<generation>" and then bumps the generation in the control object "<name>". Workers attach to
+// the current version, populate from or query it directly, and attach again once stale() reports a newer version:
+//
+//   cpop::ShmPublisher publisher("/myapp-config");          // in the process that parses the config
+//   publisher.publish(cpop::XMLParser::parseFromFile("config.xml"));
+//
+//   auto shared = cpop::ShmTree::attach("/myapp-config");   // in each worker
+//   cpop::populateFromTree(config, shared.tree(), "config");
+//
+// A version stays mapped for every worker attached to it after it has been replaced or the publisher is gone.
+// On glibc older than 2.34 link with -lrt.
+namespace cpop
+{
+
+namespace detail {
+  static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free, "the generation is shared between processes");
+
+  struct ShmControl {
+      std::uint64_t generation; // of the current version, 0 before the first publish; only accessed through atomic_ref
+  };
+
+  [[noreturn]] inline void throwShmError(std::string_view what, const std::string& name) {
+      throw std::system_error(errno, std::generic_category(), std::format("{} {}", what, name));
+  }
+
+  inline std::string shmVersionName(const std::string& name, std::uint64_t generation) {
+      return std::format("{}.{}", name, generation);
+  }
+
+  // A whole shared memory object mapped into this process
+  class ShmMapping {
+  public:
+      ShmMapping() = default;
+
+      // Opens an existing object read only. Returns an empty mapping if it does not exist.
+      static ShmMapping openReadOnly(const std::string& name) {
+          const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+          if (fd < 0) {
+              if (errno == ENOENT) {
+                  return {};
+              }
+              throwShmError("cannot open shared memory", name);
+          }
+          struct stat info{};
+          if (::fstat(fd, &info) != 0) {
+              ::close(fd);
+              throwShmError("cannot stat shared memory", name);
+          }
+          return map(fd, static_cast<std::size_t>(info.st_size), PROT_READ, name);
+      }
+
+      // Opens or creates an object of size bytes for writing, new objects read as zeros
+      static ShmMapping openWritable(const std::string& name, std::size_t size, int flags) {
+          const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | flags, 0644);
+          if (fd < 0) {
+              throwShmError("cannot create shared memory", name);
+          }
+          if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+              ::close(fd);
+              throwShmError("cannot size shared memory", name);
+          }
+          return map(fd, size, PROT_READ | PROT_WRITE, name);
+      }
+
+      ShmMapping(const ShmMapping&) = delete;
+      ShmMapping& operator=(const ShmMapping&) = delete;
+
+      ShmMapping(ShmMapping&& other) noexcept
+          : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+      ShmMapping& operator=(ShmMapping&& other) noexcept {
+          if (this != &other) {
+              unmap();
+              data_ = std::exchange(other.data_, nullptr);
+              size_ = std::exchange(other.size_, 0);
+          }
+          return *this;
+      }
+
+      ~ShmMapping() { unmap(); }
+
+      [[nodiscard]] bool empty() const { return data_ == nullptr; }
+      [[nodiscard]] std::span<std::byte> bytes() const { return {static_cast<std::byte*>(data_), size_}; }
+
+      [[nodiscard]] std::uint64_t& generation() const {
+          return static_cast<ShmControl*>(data_)->generation;
+      }
+
+  private:
+      void* data_ = nullptr;
+      std::size_t size_ = 0;
+
+      ShmMapping(void* data, std::size_t size) : data_(data), size_(size) {}
+
+      static ShmMapping map(int fd, std::size_t size, int protection, const std::string& name) {
+          void* data = size == 0 ? nullptr : ::mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+          const int map_error = errno;
+          ::close(fd); // the mapping keeps the object alive
+          if (data == MAP_FAILED) {
+              errno = map_error;
+              throwShmError("cannot map shared memory", name);
+          }
+          if (size < sizeof(ShmControl)) {
+              if (data != nullptr) {
+                  ::munmap(data, size);
+              }
+              // An object of size 0 has been created but not sized yet, e.g. by a publisher that is starting
+              errno = size == 0 ? EAGAIN : EBADMSG;
+              throwShmError("cannot map shared memory", name);
+          }
+          return {data, size};
+      }
+
+      void unmap() {
+          if (data_ != nullptr) {
+              ::munmap(data_, size_);
+          }
+      }
+  };
+}
+
+// Publishes versions of a config tree under name, which follows the rules of shm_open, e.g. "/myapp-config".
+// One publisher per name at a time. Not thread safe.
+class ShmPublisher {
+public:
+    explicit ShmPublisher(std::string name)
+        : name_(std::move(name)),
+          control_(detail::ShmMapping::openWritable(name_, sizeof(detail::ShmControl), 0)),
+          // A previous publisher of the same name may have left its control object behind, continue its generations
+          generation_(std::atomic_ref(control_.generation()).load(std::memory_order_acquire)) {}
+
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+    ShmPublisher(ShmPublisher&&) = delete;
+    ShmPublisher& operator=(ShmPublisher&&) = delete;
+
+    // Removes the names of the control object and the current version. Attached workers keep their mappings.
+    ~ShmPublisher() {
+        if (generation_ != 0) {
+            ::shm_unlink(detail::shmVersionName(name_, generation_).c_str());
+        }
+        ::shm_unlink(name_.c_str());
+    }
+
+    // Writes tree as a new version and makes it the current one. Returns its generation.
+    std::uint64_t publish(const Tree& tree) {
+        const auto generation = generation_ + 1;
+        const auto image = flattenTree(tree, generation);
+        const auto version_name = detail::shmVersionName(name_, generation);
+
+        ::shm_unlink(version_name.c_str()); // left over by a publisher that did not shut down
+        {
+            const auto version = detail::ShmMapping::openWritable(version_name, image.size(), O_EXCL);
+            std::memcpy(version.bytes().data(), image.data(), image.size());
+        }
+
+        // Release: a worker that sees the new generation also sees the complete version
+        std::atomic_ref(control_.generation()).store(generation, std::memory_order_release);
+        if (generation_ != 0) {
+            ::shm_unlink(detail::shmVersionName(name_, generation_).c_str());
+        }
+        generation_ = generation;
+        return generation;
+    }
+
+    [[nodiscard]] std::uint64_t generation() const { return generation_; }
+
+private:
+    std::string name_;
+    detail::ShmMapping control_;
+    std::uint64_t generation_;
+};
+
+// One version of a config published by a ShmPublisher, mapped read only into this process
+class ShmTree {
+public:
+    // Attaches to the current version. Throws std::system_error if nothing is published under name, or if the
+    // current version is not a valid image of its generation; the message names the shared memory object.
+    static ShmTree attach(const std::string& name) {
+        auto control = openControl(name);
+        if (control.empty()) {
+            errno = ENOENT;
+            detail::throwShmError("no config published as", name);
+        }
+
+        while (true) {
+            const auto generation = currentGeneration(control);
+            if (generation == 0) {
+                errno = ENOENT;
+                detail::throwShmError("no config published as", name);
+            }
+            // The publisher removes a version once the next one is current, then read the generation again
+            const auto version_name = detail::shmVersionName(name, generation);
+            auto version = detail::ShmMapping::openReadOnly(version_name);
+            if (version.empty()) {
+                if (currentGeneration(control) == generation) {
+                    errno = ENOENT;
+                    detail::throwShmError("config no longer published as", name);
+                }
+                continue;
+            }
+            FlatTree tree = validate(version, version_name);
+            if (tree.generation() == generation) {
+                return ShmTree(std::move(control), std::move(version), std::move(tree));
+            }
+            // Another publisher may have replaced the version meanwhile, which bumps the generation again
+            if (currentGeneration(control) == generation) {
+                errno = EBADMSG;
+                detail::throwShmError(std::format("image of generation {} published as", tree.generation()),
+                                      version_name);
+            }
+        }
+    }
+
+    [[nodiscard]] const FlatTree& tree() const { return tree_; }
+    [[nodiscard]] std::uint64_t generation() const { return tree_.generation(); }
+
+    // Whether a newer version has been published since this one, so that attaching again picks it up
+    [[nodiscard]] bool stale() const { return currentGeneration(control_) != tree_.generation(); }
+
+private:
+    detail::ShmMapping control_;
+    detail::ShmMapping version_;
+    FlatTree tree_;
+
+    ShmTree(detail::ShmMapping control, detail::ShmMapping version, FlatTree tree)
+        : control_(std::move(control)), version_(std::move(version)), tree_(std::move(tree)) {}
+
+    // A publisher that is starting creates the control object before sizing it, which is waited for briefly
+    static detail::ShmMapping openControl(const std::string& name) {
+        constexpr int kAttempts = 100;
+        for (int attempt = 1;; ++attempt) {
+            try {
+                return detail::ShmMapping::openReadOnly(name);
+            } catch (const std::system_error& e) {
+                if (e.code() != std::errc::resource_unavailable_try_again || attempt == kAttempts) {
+                    throw;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    static FlatTree validate(const detail::ShmMapping& version, const std::string& version_name) {
+        try {
+            return FlatTree(version.bytes());
+        } catch (const ParseError& e) {
+            errno = EBADMSG;
+            detail::throwShmError(std::format("{} in shared memory", e.what()), version_name);
+        }
+    }
+
+    // The control object is mapped read only; a lock-free atomic load does not write
+    static std::uint64_t currentGeneration(const detail::ShmMapping& control) {
+        return std::atomic_ref(control.generation()).load(std::memory_order_acquire);
+    }
+};
+
+}
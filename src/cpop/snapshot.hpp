@@ -0,0 +1,234 @@
+#pragma once
+
+#include "cpop/populate.hpp"
+#include "cpop/tree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Publishing populated configs to many reader threads without a mutex on the read path.
+//
+// A ConfigHandle keeps published versions in slots, each with reader counts striped over cache lines, so that
+// readers on different threads rarely touch the same line. Reading is wait-free: a reader enters a short window,
+// loads the current slot, pins it with one increment of its stripe and leaves the window, without ever retrying.
+// A publish drains readers out of both windows in turn before a slot it replaced may be reused, and reuses a slot
+// only once its last reader is gone. While every slot is pinned it adds slots, up to kMaxSlots, and only then blocks.
+namespace cpop
+{
+
+template<typename T>
+class ConfigHandle;
+
+namespace detail {
+  inline constexpr std::size_t kReaderStripes = 16;
+
+  // One reader count on a cache line of its own
+  struct alignas(64) ReaderStripe {
+      std::atomic<std::uint32_t> count{0};
+  };
+
+  using ReaderCounts = std::array<ReaderStripe, kReaderStripes>;
+
+  // Threads are spread over the stripes round robin, the first time each of them reads
+  inline std::size_t readerStripe() {
+      static std::atomic<std::size_t> next{0};
+      thread_local const std::size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % kReaderStripes;
+      return stripe;
+  }
+
+  // Sequentially consistent, as draining the window pairs the store of the current slot with these loads
+  inline std::uint64_t readerSum(const ReaderCounts& counts) {
+      std::uint64_t sum = 0;
+      for (const auto& stripe : counts) {
+          sum += stripe.count.load();
+      }
+      return sum;
+  }
+}
+
+// Read-only view of one published version. The version stays alive for as long as the snapshot does.
+template<typename T>
+class Snapshot {
+public:
+    Snapshot() = default;
+
+    Snapshot(Snapshot&& other) noexcept
+        : readers_(std::exchange(other.readers_, nullptr)),
+          value_(std::exchange(other.value_, nullptr)),
+          version_(std::exchange(other.version_, 0)) {}
+
+    Snapshot& operator=(Snapshot&& other) noexcept {
+        if (this != &other) {
+            release();
+            readers_ = std::exchange(other.readers_, nullptr);
+            value_ = std::exchange(other.value_, nullptr);
+            version_ = std::exchange(other.version_, 0);
+        }
+        return *this;
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    ~Snapshot() { release(); }
+
+    [[nodiscard]] const T& operator*() const noexcept { return *value_; }
+    [[nodiscard]] const T* operator->() const noexcept { return value_; }
+    [[nodiscard]] const T* get() const noexcept { return value_; }
+    [[nodiscard]] explicit operator bool() const noexcept { return value_ != nullptr; }
+
+    // 0 for an empty snapshot, otherwise the value returned by the publish that produced it
+    [[nodiscard]] std::uint64_t version() const noexcept { return version_; }
+
+private:
+    friend class ConfigHandle<T>;
+
+    // readers is the stripe this snapshot pinned, it is released on that stripe from whichever thread
+    Snapshot(std::atomic<std::uint32_t>* readers, const T* value, std::uint64_t version)
+        : readers_(readers), value_(value), version_(version) {}
+
+    void release() noexcept {
+        if (readers_ != nullptr) {
+            readers_->fetch_sub(1, std::memory_order_release);
+            readers_ = nullptr;
+        }
+    }
+
+    std::atomic<std::uint32_t>* readers_ = nullptr;
+    const T* value_ = nullptr;
+    std::uint64_t version_ = 0;
+};
+
+template<typename T>
+class ConfigHandle {
+public:
+    // Versions that may be pinned at the same time before publish blocks
+    static constexpr std::size_t kMaxSlots = 256;
+
+    ConfigHandle() = default;
+    explicit ConfigHandle(T initial) { publish(std::move(initial)); }
+
+    ConfigHandle(const ConfigHandle&) = delete;
+    ConfigHandle& operator=(const ConfigHandle&) = delete;
+    ConfigHandle(ConfigHandle&&) = delete;
+    ConfigHandle& operator=(ConfigHandle&&) = delete;
+    ~ConfigHandle() = default;
+
+    // Returns an empty snapshot if nothing has been published yet. Wait-free: a fixed number of steps, no retries.
+    [[nodiscard]] Snapshot<T> load() const {
+        const auto stripe = detail::readerStripe();
+        auto& window = windows_[epoch_.load() & 1][stripe].count;
+        window.fetch_add(1);
+
+        Snapshot<T> snapshot;
+        // A slot stops being current before publish drains the windows, so the slot loaded here cannot be reused
+        // until this reader has pinned it and left its window
+        if (const auto current = current_.load(); current != 0) {
+            auto& slot = *slots_[current & kSlotMask];
+            auto& readers = slot.readers[stripe].count;
+            readers.fetch_add(1);
+            snapshot = Snapshot<T>(&readers, &*slot.value, current >> kSlotBits);
+        }
+
+        window.fetch_sub(1, std::memory_order_release);
+        return snapshot;
+    }
+
+    // Reuses a slot without readers, or adds one. Blocks only while all kMaxSlots versions are pinned.
+    std::uint64_t publish(T value) {
+        const std::lock_guard lock(publish_mutex_);
+
+        const auto current = current_.load(std::memory_order_relaxed);
+        const auto next = (current >> kSlotBits) + 1;
+        const auto index = acquireFreeSlot(current);
+        Slot& slot = *slots_[index];
+
+        slot.value.reset();
+        slot.value.emplace(std::move(value));
+        current_.store((next << kSlotBits) | index);
+        drainWindow();
+        return next;
+    }
+
+    [[nodiscard]] std::uint64_t version() const noexcept {
+        return current_.load(std::memory_order_acquire) >> kSlotBits;
+    }
+
+private:
+    static constexpr std::uint64_t kSlotBits = 8;
+    static constexpr std::uint64_t kSlotMask = (1U << kSlotBits) - 1;
+    static_assert(kMaxSlots <= kSlotMask + 1);
+
+    struct Slot {
+        mutable detail::ReaderCounts readers;
+        std::optional<T> value;
+    };
+
+    // Readers that are between loading current_ and pinning its slot, counted under the parity of epoch_.
+    // A reader may read the parity before a flip and enter its window only after that window was drained, and then
+    // load the slot this publish made current. Draining both parities, each after a flip, waits for such a reader
+    // before the next publish replaces that slot, so no slot can be reused under a reader about to pin it.
+    void drainWindow() {
+        for (int flip = 0; flip < 2; ++flip) {
+            const auto parity = epoch_.fetch_add(1) & 1;
+            // Readers leave the window in a few steps and later readers count under the other parity, so this ends
+            while (detail::readerSum(windows_[parity]) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Any slot that is not current has been drained out of both windows by the publish that replaced it,
+    // so nobody pins it anymore and it is free once its readers are gone
+    std::uint64_t acquireFreeSlot(std::uint64_t current) {
+        const auto currentSlot = current == 0 ? kMaxSlots : current & kSlotMask;
+        for (auto backoff = std::chrono::microseconds(1);; backoff = std::min(backoff * 2, std::chrono::microseconds(1000))) {
+            for (std::size_t i = 0; i < slot_count_; ++i) {
+                if (i != currentSlot && detail::readerSum(slots_[i]->readers) == 0) {
+                    return i;
+                }
+            }
+            if (slot_count_ < kMaxSlots) {
+                slots_[slot_count_] = std::make_unique<Slot>();
+                return slot_count_++;
+            }
+            std::this_thread::sleep_for(backoff);
+        }
+    }
+
+    // Packs the current version and the slot holding it, 0 while nothing is published
+    std::atomic<std::uint64_t> current_{0};
+    std::atomic<std::uint64_t> epoch_{0};
+    mutable std::array<detail::ReaderCounts, 2> windows_;
+    // Added on demand and never removed while the handle lives, readers reach them through current_
+    std::array<std::unique_ptr<Slot>, kMaxSlots> slots_;
+    std::size_t slot_count_ = 0;
+    std::mutex publish_mutex_;
+};
+
+// Populates a fresh T and publishes it. If population throws, the previously published version stays current.
+template<typename T>
+std::uint64_t publishFromTree(ConfigHandle<T>& handle, const Tree& tree) {
+    T obj;
+    populateFromTree(obj, tree);
+    return handle.publish(std::move(obj));
+}
+
+template<typename T>
+std::uint64_t publishFromTree(ConfigHandle<T>& handle, const Tree& tree, std::string topLevelTag) {
+    T obj;
+    populateFromTree(obj, tree, std::move(topLevelTag));
+    return handle.publish(std::move(obj));
+}
+
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "cpop/populate.hpp"
+#include "cpop/symbols.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/detail/xml_reader.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// XML documents parsed at compile time, e.g. default configs baked into the binary.
+//
+//   inline constexpr std::string_view kDefaults = R"(<config><port>8080</port></config>)";
+//   constexpr auto defaults = cpop::staticXml<kDefaults>;   // a malformed document fails the build
+//
+//   Config config;
+//   cpop::populateFromStatic(config, defaults, "config");   // no parsing at runtime
+//
+// The cpop_embed_xml CMake function generates such a string_view from a file.
+// The result follows XMLParser: attributes are children of an "<xmlattr>" element and comments are "<xmlcomment>" elements.
+namespace cpop
+{
+
+// One element of a StaticTree. Elements are stored in document order, so the children of an element
+// follow it directly and its subtree ends at end.
+struct StaticElement {
+    std::size_t key_offset = 0;
+    std::size_t key_size = 0;
+    std::size_t value_offset = 0;
+    std::size_t value_size = 0;
+    std::size_t end = 0;
+    bool nested = false;
+};
+
+template<std::size_t Elements, std::size_t Chars>
+struct StaticTree {
+    std::array<StaticElement, Elements> elements{};
+    std::array<char, Chars> chars{}; // keys and decoded values of all elements
+
+    [[nodiscard]] constexpr std::size_t size() const { return Elements; }
+
+    [[nodiscard]] constexpr std::string_view key(std::size_t index) const {
+        return {chars.data() + elements[index].key_offset, elements[index].key_size};
+    }
+
+    [[nodiscard]] constexpr std::string_view value(std::size_t index) const {
+        return {chars.data() + elements[index].value_offset, elements[index].value_size};
+    }
+
+    // Builds the equivalent runtime tree, without any text parsing
+    [[nodiscard]] Tree toTree() const {
+        struct Level {
+            Tree* tree;
+            std::size_t next;
+            std::size_t end;
+        };
+
+        Tree result;
+        std::vector<Level> pending{{&result, 0, Elements}};
+        while (!pending.empty()) {
+            auto& level = pending.back();
+            if (level.next == level.end) {
+                pending.pop_back();
+                continue;
+            }
+
+            const auto index = level.next;
+            const auto& source = elements[index];
+            level.next = source.end;
+
+            auto& elem = level.tree->emplace_back();
+            elem.key = key(index);
+            elem.symbol = SymbolTable::global().intern(elem.key);
+            if (source.nested) {
+                auto& children = elem.content.template emplace<std::vector<Element>>();
+                pending.push_back({&children, index + 1, source.end});
+            } else {
+                elem.content = Node{std::string(value(index))};
+            }
+        }
+        return result;
+    }
+};
+
+namespace detail {
+  // Collects the document into growable storage during constant evaluation, before it is copied into a StaticTree
+  class StaticTreeBuilder {
+  public:
+      std::vector<StaticElement> elements;
+      std::string chars;
+
+      constexpr void startElement(std::string_view name, std::size_t /*offset*/) {
+          openChild();
+          open_.push_back({.index = add(name), .text = {}, .attributes = 0, .attributes_open = false});
+      }
+
+      constexpr void attribute(std::string_view name, std::string value, std::size_t /*offset*/) {
+          auto& top = open_.back();
+          if (!top.attributes_open) {
+              elements[top.index].nested = true;
+              top.attributes = add("<xmlattr>");
+              elements[top.attributes].nested = true;
+              top.attributes_open = true;
+          }
+          addLeaf(name, value);
+      }
+
+      constexpr void text(std::string value) {
+          open_.back().text += value;
+      }
+
+      constexpr void comment(std::string_view text, std::size_t /*offset*/) {
+          openChild();
+          addLeaf("<xmlcomment>", text);
+      }
+
+      constexpr void endElement() {
+          closeAttributes();
+          auto& top = open_.back();
+          if (!elements[top.index].nested) {
+              setValue(top.index, top.text);
+          }
+          elements[top.index].end = elements.size();
+          open_.pop_back();
+      }
+
+  private:
+      struct Open {
+          std::size_t index = 0;
+          std::string text;
+          std::size_t attributes = 0;
+          bool attributes_open = false;
+      };
+
+      std::vector<Open> open_;
+
+      constexpr std::size_t add(std::string_view key) {
+          StaticElement elem;
+          elem.key_offset = chars.size();
+          elem.key_size = key.size();
+          chars += key;
+          elements.push_back(elem);
+          return elements.size() - 1;
+      }
+
+      constexpr void addLeaf(std::string_view key, std::string_view value) {
+          const auto index = add(key);
+          setValue(index, value);
+          elements[index].end = elements.size();
+      }
+
+      constexpr void setValue(std::size_t index, std::string_view value) {
+          elements[index].value_offset = chars.size();
+          elements[index].value_size = value.size();
+          chars += value;
+      }
+
+      constexpr void closeAttributes() {
+          if (!open_.empty() && open_.back().attributes_open) {
+              elements[open_.back().attributes].end = elements.size();
+              open_.back().attributes_open = false;
+          }
+      }
+
+      // Called before anything is added inside the innermost open element
+      constexpr void openChild() {
+          closeAttributes();
+          if (!open_.empty()) {
+              elements[open_.back().index].nested = true;
+          }
+      }
+  };
+
+  template<const std::string_view& Xml>
+  consteval auto buildStaticTree() {
+      constexpr auto sizes = [] {
+          StaticTreeBuilder builder;
+          readXml(Xml, builder);
+          return std::pair{builder.elements.size(), builder.chars.size()};
+      }();
+
+      StaticTreeBuilder builder;
+      readXml(Xml, builder);
+
+      StaticTree<sizes.first, sizes.second> tree;
+      for (std::size_t i = 0; i < sizes.first; ++i) {
+          tree.elements[i] = builder.elements[i];
+      }
+      for (std::size_t i = 0; i < sizes.second; ++i) {
+          tree.chars[i] = builder.chars[i];
+      }
+      return tree;
+  }
+}
+
+// The document in Xml, parsed during compilation
+template<const std::string_view& Xml>
+inline constexpr auto staticXml = detail::buildStaticTree<Xml>();
+
+template<typename T, std::size_t Elements, std::size_t Chars>
+void populateFromStatic(T& obj, const StaticTree<Elements, Chars>& tree) {
+    populateFromTree(obj, tree.toTree());
+}
+
+template<typename T, std::size_t Elements, std::size_t Chars>
+void populateFromStatic(T& obj, const StaticTree<Elements, Chars>& tree, std::string topLevelTag) {
+    populateFromTree(obj, tree.toTree(), std::move(topLevelTag));
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+// Optional instrumentation of the parse and populate pipeline.
+//
+// Define CPOP_ENABLE_STATS (cmake option of the same name) to collect stats. Without it StatsScope and
+// all recording hooks are empty inline functions, so instrumented code compiles down to nothing.
+//
+//   cpop::Stats stats;
+//   {
+//       cpop::StatsScope scope(stats);
+//       auto tree = cpop::XMLParser::parseFromFile("config.xml");
+//       cpop::populateFromTree(config, tree, "config");
+//   }
+namespace cpop
+{
+
+struct Stats {
+#ifdef CPOP_ENABLE_STATS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    struct Conversions {
+        std::size_t boolean = 0;
+        std::size_t signed_integer = 0;
+        std::size_t unsigned_integer = 0;
+        std::size_t floating_point = 0;
+        std::size_t string = 0;
+        std::size_t other = 0;
+        std::size_t failed = 0;
+    };
+
+    std::chrono::nanoseconds read_time{};     // File I/O in parseFromFile
+    std::chrono::nanoseconds parse_time{};    // Building the Tree from xml text
+    std::chrono::nanoseconds populate_time{}; // populateFromTree, including convert_time
+    std::chrono::nanoseconds convert_time{};  // Converting node values to field types
+
+    std::size_t bytes = 0;              // Bytes of xml parsed
+    std::size_t nodes = 0;              // Elements created by the parser
+    std::size_t parallel_chunks = 0;    // Chunks parseParallel cut a document into, 0 for a document parsed as a whole
+    std::size_t lookup_comparisons = 0; // Key comparisons made while searching the tree
+    std::size_t planned_lookups = 0;    // Fields found at the position recorded in a populate plan, without searching
+    std::size_t warnings = 0;
+    Conversions conversions;
+
+    // Time spent finding elements, i.e. populating minus converting
+    [[nodiscard]] std::chrono::nanoseconds lookup_time() const {
+        return populate_time - convert_time;
+    }
+};
+
+namespace detail::stats {
+#ifdef CPOP_ENABLE_STATS
+    inline Stats*& current() {
+        thread_local Stats* stats = nullptr;
+        return stats;
+    }
+
+    // Adds the lifetime of the timer to one of the durations of the current stats
+    class Timer {
+    public:
+        explicit Timer(std::chrono::nanoseconds Stats::*target)
+            : stats_(current()), target_(target), start_(std::chrono::steady_clock::now()) {}
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+        Timer(Timer&&) = delete;
+        Timer& operator=(Timer&&) = delete;
+
+        ~Timer() {
+            if (stats_ != nullptr) {
+                stats_->*target_ += std::chrono::steady_clock::now() - start_;
+            }
+        }
+
+    private:
+        Stats* stats_;
+        std::chrono::nanoseconds Stats::*target_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    inline void add(std::size_t Stats::*counter, std::size_t amount = 1) {
+        if (auto* stats = current()) {
+            stats->*counter += amount;
+        }
+    }
+
+    inline void addConversion(std::size_t Stats::Conversions::*counter) {
+        if (auto* stats = current()) {
+            stats->conversions.*counter += 1;
+        }
+    }
+#else
+    class Timer {
+    public:
+        explicit Timer(std::chrono::nanoseconds Stats::* /*target*/) {}
+    };
+
+    inline void add(std::size_t Stats::* /*counter*/, std::size_t /*amount*/ = 1) {}
+    inline void addConversion(std::size_t Stats::Conversions::* /*counter*/) {}
+#endif
+}
+
+// Collects stats of every parse and populate on this thread while the scope is alive. Scopes nest.
+class StatsScope {
+public:
+#ifdef CPOP_ENABLE_STATS
+    explicit StatsScope(Stats& stats) : previous_(std::exchange(detail::stats::current(), &stats)) {}
+    ~StatsScope() { detail::stats::current() = previous_; }
+#else
+    explicit StatsScope(Stats& /*stats*/) {}
+    ~StatsScope() = default;
+#endif
+
+    StatsScope(const StatsScope&) = delete;
+    StatsScope& operator=(const StatsScope&) = delete;
+    StatsScope(StatsScope&&) = delete;
+    StatsScope& operator=(StatsScope&&) = delete;
+
+#ifdef CPOP_ENABLE_STATS
+private:
+    Stats* previous_;
+#endif
+};
+
+}
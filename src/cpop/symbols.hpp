@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace cpop
+{
+
+// Interned key. Equal symbols from the same table mean equal keys, so keys compare as integers.
+using Symbol = std::uint32_t;
+inline constexpr Symbol kNoSymbol = 0;
+
+// Thread safe, append only table of interned keys.
+// Parsers intern element keys into SymbolTable::global(), which is shared by every parse in the process.
+class SymbolTable {
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    SymbolTable(SymbolTable&&) = delete;
+    SymbolTable& operator=(SymbolTable&&) = delete;
+    ~SymbolTable() = default;
+
+    static SymbolTable& global() {
+        static SymbolTable table;
+        return table;
+    }
+
+    Symbol intern(std::string_view name) {
+        {
+            const std::shared_lock lock(mutex_);
+            if (auto iter = symbols_.find(name); iter != symbols_.end()) {
+                return iter->second;
+            }
+        }
+
+        const std::unique_lock lock(mutex_);
+        if (auto iter = symbols_.find(name); iter != symbols_.end()) {
+            return iter->second;
+        }
+        const auto& stored = names_.emplace_back(name);
+        const auto symbol = static_cast<Symbol>(names_.size());
+        symbols_.emplace(stored, symbol);
+        return symbol;
+    }
+
+    // kNoSymbol if the name was never interned
+    [[nodiscard]] Symbol find(std::string_view name) const {
+        const std::shared_lock lock(mutex_);
+        auto iter = symbols_.find(name);
+        return iter == symbols_.end() ? kNoSymbol : iter->second;
+    }
+
+    [[nodiscard]] std::string_view name(Symbol symbol) const {
+        const std::shared_lock lock(mutex_);
+        if (symbol == kNoSymbol || symbol > names_.size()) {
+            return {};
+        }
+        return names_[symbol - 1];
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        const std::shared_lock lock(mutex_);
+        return names_.size();
+    }
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> names_; // deque so that views into the names stay valid as it grows
+    std::unordered_map<std::string_view, Symbol> symbols_;
+};
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "cpop/location.hpp"
+#include "cpop/symbols.hpp"
+
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -17,8 +21,69 @@ using Content = std::variant<std::vector<Element>, Node>;
 struct Element {
     std::string key;
     Content content;
+    // key interned in SymbolTable::global(), or kNoSymbol (e.g. for hand built trees) to compare the key string instead
+    Symbol symbol = kNoSymbol;
+    // where the element starts in the parsed document, unknown for hand built elements
+    [[no_unique_address]] SourceOffset offset{};
 };
 
 using Tree = std::vector<Element>;
 
+// Destroys a tree level by level instead of recursing once per nesting level like the destructor of a Tree does.
+// Element stays an aggregate, so a Tree's own destructor still recurses. The library tears down every tree it owns
+// with destroyTree: trees passed to populateFromTree as rvalues, partial trees of failed parses, and the
+// intermediate trees of parseParallel and composeFiles. Use it as well to drop trees you own that may be
+// arbitrarily deep, e.g. parsed from untrusted or machine generated documents.
+inline void destroyTree(Tree&& tree) {
+    std::vector<Tree> pending;
+    pending.push_back(std::move(tree));
+    while (!pending.empty()) {
+        Tree level = std::move(pending.back());
+        pending.pop_back();
+        for (auto& elem : level) {
+            if (auto* children = std::get_if<std::vector<Element>>(&elem.content); children != nullptr && !children->empty()) {
+                pending.push_back(std::move(*children));
+            }
+        }
+        // Every element of level is shallow now, so destroying it does not recurse
+    }
+}
+
+// Copies a tree level by level instead of recursing once per nesting level like the copy constructor of a Tree does
+inline Tree copyTree(const Tree& tree) {
+    Tree result;
+    std::vector<std::pair<const Tree*, Tree*>> pending{{&tree, &result}};
+    while (!pending.empty()) {
+        const auto [from, to] = pending.back();
+        pending.pop_back();
+        // Reserved, so the children of copied elements stay in place while the level is filled
+        to->reserve(from->size());
+        for (const auto& elem : *from) {
+            auto& copy = to->emplace_back(Element{.key = elem.key, .content = Node{}, .symbol = elem.symbol, .offset = elem.offset});
+            if (const auto* node = std::get_if<Node>(&elem.content)) {
+                copy.content = *node;
+            } else {
+                pending.emplace_back(&std::get<std::vector<Element>>(elem.content), &copy.content.emplace<std::vector<Element>>());
+            }
+        }
+    }
+    return result;
+}
+
+namespace detail {
+  // Destroys a tree with destroyTree when leaving its scope, also when an exception leaves it
+  class TreeDisposer {
+  public:
+      explicit TreeDisposer(Tree& tree) : tree_(tree) {}
+      TreeDisposer(const TreeDisposer&) = delete;
+      TreeDisposer& operator=(const TreeDisposer&) = delete;
+      TreeDisposer(TreeDisposer&&) = delete;
+      TreeDisposer& operator=(TreeDisposer&&) = delete;
+      ~TreeDisposer() { destroyTree(std::move(tree_)); }
+
+  private:
+      Tree& tree_;
+  };
+}
+
 }
@@ -0,0 +1,345 @@
+#include "cpop/error.hpp"
+#include "cpop/fixed.hpp"
+#include "cpop/params.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/populate.hpp"
+#include "cpop/parsers/xml_parser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <format>
+#include <new>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Allocation budgets for the XMLParser -> Tree -> Populator pipeline.
+//
+// Global operator new/delete are replaced with counting hooks. Each scenario runs a representative document
+// through parsing and populateFromTree and must stay within its allocation count and peak byte budget.
+// When a budget is exceeded the allocations are broken down by phase and size to show where they come from.
+// Budgets are deliberately loose upper bounds; lower them when an optimization lands.
+namespace
+{
+
+constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+struct PhaseCounters {
+    std::string_view name;
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+};
+
+struct Counters {
+    bool tracking = false;
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+    std::size_t live_bytes = 0;
+    std::size_t peak_bytes = 0;
+    std::size_t current_phase = 0;
+    std::array<PhaseCounters, 8> phases{};
+    std::size_t phase_count = 0;
+    std::array<std::size_t, 8> size_buckets{}; // <=16, <=32, <=64, <=128, <=256, <=1K, <=4K, larger
+};
+
+constinit Counters counters;
+
+constexpr std::array<std::string_view, 8> kBucketNames{
+    "<= 16B", "<= 32B", "<= 64B", "<= 128B", "<= 256B", "<= 1KiB", "<= 4KiB", "> 4KiB"};
+
+std::size_t bucketOf(std::size_t size) {
+    constexpr std::array<std::size_t, 7> limits{16, 32, 64, 128, 256, 1024, 4096};
+    for (std::size_t i = 0; i < limits.size(); ++i) {
+        if (size <= limits[i]) {
+            return i;
+        }
+    }
+    return limits.size();
+}
+
+void recordAllocation(std::size_t size) {
+    counters.live_bytes += size;
+    if (!counters.tracking) {
+        return;
+    }
+    counters.allocations += 1;
+    counters.bytes += size;
+    counters.peak_bytes = std::max(counters.peak_bytes, counters.live_bytes);
+    counters.phases[counters.current_phase].allocations += 1;
+    counters.phases[counters.current_phase].bytes += size;
+    counters.size_buckets[bucketOf(size)] += 1;
+}
+
+// Every block carries its size in a header in front of it, so deallocation can update the live byte count
+void* allocate(std::size_t size, std::size_t alignment) {
+    const std::size_t header = std::max(kHeader, alignment);
+    const std::size_t total = (header + size + alignment - 1) / alignment * alignment;
+    auto* block = static_cast<std::byte*>(std::aligned_alloc(alignment, total));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *reinterpret_cast<std::size_t*>(block + header - sizeof(std::size_t)) = size; // NOLINT
+    recordAllocation(size);
+    return block + header;
+}
+
+void deallocate(void* ptr, std::size_t alignment) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    const std::size_t header = std::max(kHeader, alignment);
+    auto* block = static_cast<std::byte*>(ptr) - header;
+    counters.live_bytes -= *reinterpret_cast<std::size_t*>(block + header - sizeof(std::size_t)); // NOLINT
+    std::free(block); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+    if (void* ptr = allocate(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+}
+
+void* operator new(std::size_t size) { return allocateOrThrow(size, kHeader); }
+void* operator new[](std::size_t size) { return allocateOrThrow(size, kHeader); }
+void* operator new(std::size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align) { return allocateOrThrow(size, static_cast<std::size_t>(align)); }
+void* operator new(std::size_t size, const std::nothrow_t& /*tag*/) noexcept { return allocate(size, kHeader); }
+void* operator new[](std::size_t size, const std::nothrow_t& /*tag*/) noexcept { return allocate(size, kHeader); }
+
+void operator delete(void* ptr) noexcept { deallocate(ptr, kHeader); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr, kHeader); }
+void operator delete(void* ptr, std::size_t /*size*/) noexcept { deallocate(ptr, kHeader); }
+void operator delete[](void* ptr, std::size_t /*size*/) noexcept { deallocate(ptr, kHeader); }
+void operator delete(void* ptr, std::align_val_t align) noexcept { deallocate(ptr, static_cast<std::size_t>(align)); }
+void operator delete[](void* ptr, std::align_val_t align) noexcept { deallocate(ptr, static_cast<std::size_t>(align)); }
+void operator delete(void* ptr, std::size_t /*size*/, std::align_val_t align) noexcept { deallocate(ptr, static_cast<std::size_t>(align)); }
+void operator delete[](void* ptr, std::size_t /*size*/, std::align_val_t align) noexcept { deallocate(ptr, static_cast<std::size_t>(align)); }
+void operator delete(void* ptr, const std::nothrow_t& /*tag*/) noexcept { deallocate(ptr, kHeader); }
+void operator delete[](void* ptr, const std::nothrow_t& /*tag*/) noexcept { deallocate(ptr, kHeader); }
+
+namespace
+{
+
+// Attributes the allocations made during its lifetime to a named phase
+class Phase {
+public:
+    explicit Phase(std::string_view name) : previous_(counters.current_phase) {
+        std::size_t index = 0;
+        while (index < counters.phase_count && counters.phases[index].name != name) {
+            ++index;
+        }
+        if (index == counters.phase_count && index < counters.phases.size()) {
+            counters.phases[index].name = name;
+            ++counters.phase_count;
+        }
+        counters.current_phase = std::min(index, counters.phases.size() - 1);
+    }
+
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+    Phase(Phase&&) = delete;
+    Phase& operator=(Phase&&) = delete;
+
+    ~Phase() { counters.current_phase = previous_; }
+
+private:
+    std::size_t previous_;
+};
+
+struct Budget {
+    std::size_t allocations;
+    std::size_t peak_bytes;
+};
+
+template<typename Scenario>
+bool runScenario(std::string_view name, Budget budget, Scenario&& scenario) {
+    const std::size_t baseline = counters.live_bytes;
+    counters = Counters{.live_bytes = baseline, .peak_bytes = baseline};
+    counters.tracking = true;
+    {
+        const Phase phase("setup");
+        std::forward<Scenario>(scenario)();
+    }
+    counters.tracking = false;
+
+    const std::size_t peak = counters.peak_bytes - baseline;
+    const bool within = counters.allocations <= budget.allocations && peak <= budget.peak_bytes;
+    std::println("{:<16} {:>6} allocations (budget {:>6}), {:>8} peak bytes (budget {:>8}) {}",
+        name, counters.allocations, budget.allocations, peak, budget.peak_bytes, within ? "ok" : "OVER BUDGET");
+
+    if (!within) {
+        std::println("  by phase:");
+        for (std::size_t i = 0; i < counters.phase_count; ++i) {
+            const auto& phase = counters.phases[i];
+            std::println("    {:<12} {:>6} allocations {:>8} bytes", phase.name, phase.allocations, phase.bytes);
+        }
+        std::println("  by size:");
+        for (std::size_t i = 0; i < kBucketNames.size(); ++i) {
+            std::println("    {:<12} {:>6} allocations", kBucketNames[i], counters.size_buckets[i]);
+        }
+    }
+    return within;
+}
+
+template<typename T>
+void parseAndPopulate(const std::string& xml, std::string_view topLevelTag, std::string_view populatePhase = "populate") {
+    cpop::Tree tree;
+    {
+        const Phase phase("parse");
+        tree = cpop::XMLParser::parse(xml);
+    }
+    T config;
+    {
+        const Phase phase(populatePhase);
+        cpop::populateFromTree(config, tree, std::string(topLevelTag));
+    }
+    {
+        const Phase phase("destroy");
+        tree = {};
+    }
+}
+
+struct Flat {
+  cpop::Param<int> port{"port"};
+  cpop::Param<std::string> host{"host"};
+  cpop::Param<bool> debug{"debug"};
+  cpop::Param<double> ratio{"ratio"};
+  cpop::Param<unsigned int> workers{"workers"};
+  cpop::Param<std::string> log_path{"log_path"};
+  cpop::OptParam<int> backlog{"backlog"};
+  cpop::OptParam<std::string> user{"user"};
+  cpop::OptParam<bool> tls{"tls"};
+  cpop::OptParam<int> missing{"missing"};
+};
+
+struct Leaf {
+  cpop::Param<std::string> name{"name"};
+  cpop::Param<int> value{"value"};
+};
+
+struct Inner {
+  cpop::Param<Leaf> leaf{"leaf"};
+  cpop::OptParam<Leaf> other{"other"};
+};
+
+struct Middle {
+  cpop::Param<Inner> inner{"inner"};
+  cpop::Param<Leaf> leaf{"leaf"};
+};
+
+struct Nested {
+  cpop::Param<Middle> first{"first"};
+  cpop::Param<Middle> second{"second"};
+};
+
+struct Database {
+  cpop::Param<std::string> name{"name"};
+  cpop::Param<int> port{"port"};
+  cpop::OptParam<std::string> user{"user"};
+};
+
+struct DatabaseList {
+  cpop::Multiple<Database> databases{"db_list", "database"};
+};
+
+// Preallocated storage of a realtime component that reloads its config
+struct Realtime {
+  cpop::Param<int> rate{"rate"};
+  cpop::Param<cpop::FixedString<32>> device{"device"};
+  cpop::Param<std::string> log_path{"log_path"};
+  cpop::OptParam<int> priority{"priority"};
+  cpop::Multiple<int, cpop::InplaceVector<int, 8>> channels{"channels", "channel"};
+};
+
+const std::string kRealtimeXml = R"(
+    <config>
+        <rate>48000</rate>
+        <device>hw:0,0</device>
+        <log_path>/var/log/a/rather/long/path/that/does/not/fit/in/small/string/storage.log</log_path>
+        <priority>90</priority>
+        <channels><channel>0</channel><channel>1</channel><channel>4</channel></channels>
+    </config>
+)";
+
+const std::string kFlatXml = R"(
+    <config>
+        <port>8080</port>
+        <host>localhost</host>
+        <debug>true</debug>
+        <ratio>0.75</ratio>
+        <workers>16</workers>
+        <log_path>/var/log/a/rather/long/path/that/does/not/fit/in/small/string/storage.log</log_path>
+        <backlog>128</backlog>
+        <user>service</user>
+        <tls>false</tls>
+    </config>
+)";
+
+std::string nestedXml() {
+    const std::string leaf = "<leaf><name>leaf</name><value>1</value></leaf>";
+    const std::string middle = std::format("<inner>{0}<other><name>other</name><value>2</value></other></inner>{0}", leaf);
+    return std::format("<config><first>{0}</first><second>{0}</second></config>", middle);
+}
+
+std::string multipleXml(int count) {
+    std::string xml = "<config><db_list>";
+    for (int i = 0; i < count; ++i) {
+        xml += std::format("<database><name>database_{}</name><port>{}</port><user>user</user></database>", i, 5000 + i);
+    }
+    xml += "</db_list></config>";
+    return xml;
+}
+
+}
+
+int main() {
+    const std::string nested_xml = nestedXml();
+    const std::string multiple_xml = multipleXml(200);
+    const std::string missing_xml = "<config><host>localhost</host></config>";
+    const std::string invalid_xml = "<config><port>not_a_number</port><host>localhost</host></config>";
+
+    bool ok = true;
+
+    ok &= runScenario("flat", {.allocations = 60, .peak_bytes = 6 * 1024}, [&] {
+        parseAndPopulate<Flat>(kFlatXml, "config");
+    });
+
+    ok &= runScenario("nested", {.allocations = 90, .peak_bytes = 6 * 1024}, [&] {
+        parseAndPopulate<Nested>(nested_xml, "config");
+    });
+
+    ok &= runScenario("multiple", {.allocations = 1000, .peak_bytes = 256 * 1024}, [&] {
+        parseAndPopulate<DatabaseList>(multiple_xml, "config");
+    });
+
+    ok &= runScenario("errors", {.allocations = 50, .peak_bytes = 2 * 1024}, [&] {
+        for (const auto* xml : {&missing_xml, &invalid_xml}) {
+            // The failing populate, and unwinding out of it, are counted as the error phase
+            try {
+                parseAndPopulate<Flat>(*xml, "config", "error");
+            } catch (const cpop::PopulateError&) {}
+        }
+    });
+
+    // Populating preallocated storage again from an already parsed tree must not allocate at all
+    const auto realtime_tree = cpop::XMLParser::parse(kRealtimeXml);
+    Realtime realtime;
+    cpop::populateFromTree(realtime, realtime_tree, "config");
+    ok &= runScenario("reload", {.allocations = 0, .peak_bytes = 0}, [&] {
+        const Phase phase("populate");
+        cpop::populateFromTree(realtime, realtime_tree, "config");
+    });
+
+    if (!ok) {
+        std::println("Allocation budgets exceeded");
+        return 1;
+    }
+    std::println("All allocation budgets met");
+    return 0;
+}
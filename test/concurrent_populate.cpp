@@ -0,0 +1,178 @@
+#include "cpop/error.hpp"
+#include "cpop/params.hpp"
+#include "cpop/tree.hpp"
+#include "cpop/populate.hpp"
+#include "cpop/query.hpp"
+#include "cpop/snapshot.hpp"
+#include "cpop/parsers/xml_parser.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Many threads populating different structs from one shared const Tree.
+// Built with -fsanitize=thread where available, so any hidden shared mutable state shows up as a data race.
+namespace
+{
+
+constexpr int kModules = 16;
+constexpr int kDatabases = 32;
+constexpr int kThreads = 8;
+constexpr int kIterations = 200;
+constexpr int kReaders = 6;
+constexpr int kPublishes = 2000;
+
+struct Database {
+  cpop::Param<std::string> name{"name"};
+  cpop::Param<int> port{"port"};
+};
+
+struct Storage {
+  cpop::Param<std::string> root{"root"};
+  cpop::Multiple<Database> databases{"db_list", "database"};
+};
+
+struct Network {
+  cpop::Param<std::string> host{"host"};
+  cpop::Param<int> port{"port"};
+  cpop::OptParam<bool> tls{"tls"};
+};
+
+struct Module {
+  cpop::Param<std::string> name{"name"};
+  cpop::Param<Network> network{"network"};
+};
+
+struct Master {
+  cpop::Param<Storage> storage{"storage"};
+  cpop::Param<Module> first_module{"module0"};
+};
+
+struct Broken {
+  cpop::Param<Network> network{"network"};
+  cpop::Param<int> missing{"missing"};
+};
+
+struct BrokenMaster {
+  cpop::Param<Broken> module{"module1"};
+};
+
+std::string buildXml() {
+    std::string xml = "<master><storage><root>/var/lib</root><db_list>";
+    for (int i = 0; i < kDatabases; ++i) {
+        xml += std::format("<database><name>db{}</name><port>{}</port></database>", i, 5000 + i);
+    }
+    xml += "</db_list></storage>";
+    for (int i = 0; i < kModules; ++i) {
+        xml += std::format(
+            "<module{0}><name>module{0}</name><network><host>host{0}</host><port>{1}</port><tls>true</tls></network></module{0}>",
+            i, 8000 + i);
+    }
+    xml += "</master>";
+    return xml;
+}
+
+void checkStorage(const Storage& storage) {
+    assert(storage.root.value == "/var/lib");
+    assert(storage.databases.values.size() == kDatabases);
+    for (int i = 0; i < kDatabases; ++i) {
+        const auto& database = storage.databases.values[static_cast<std::size_t>(i)];
+        assert(database.name.value == std::format("db{}", i));
+        assert(database.port.value == 5000 + i);
+    }
+}
+
+void populateWorker(const cpop::Tree& tree, int worker) {
+    for (int iteration = 0; iteration < kIterations; ++iteration) {
+        const int index = (worker + iteration) % kModules;
+
+        auto module = cpop::query<Module>(tree, std::format("master/module{}", index));
+        assert(module.name.value == std::format("module{}", index));
+        assert(module.network.value.host.value == std::format("host{}", index));
+        assert(module.network.value.port.value == 8000 + index);
+        assert(module.network.value.tls.value.value_or(false));
+
+        Master master;
+        cpop::populateFromTree(master, tree, "master");
+        checkStorage(master.storage.value);
+        assert(master.first_module.value.name.value == "module0");
+
+        BrokenMaster broken;
+        try {
+            cpop::populateFromTree(broken, tree, "master");
+            assert(false && "Should have thrown exception for missing required field");
+        } catch (const cpop::PopulateError& e) {
+            const std::vector<std::string> expected{"master", "module1", "missing"};
+            assert(e.path() == expected);
+        }
+    }
+}
+
+// Long enough to live on the heap, so that rewriting a slot is a write a reader would race with
+std::string versionText(std::uint64_t version) {
+    return std::format("published configuration version {}", version);
+}
+
+struct Versioned {
+  std::uint64_t version = 0;
+  std::string text;
+};
+
+// Readers pin versions while one thread publishes as fast as it can, so that slots are reused while readers are
+// between entering a window and pinning. A reused slot under a reader shows up as a mismatch or a data race.
+void snapshotStress() {
+    cpop::ConfigHandle<Versioned> handle(Versioned{.version = 1, .text = versionText(1)});
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < kReaders; ++reader) {
+        readers.emplace_back([&handle, &done] {
+            std::uint64_t last = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                const auto snapshot = handle.load();
+                assert(snapshot && snapshot->version == snapshot.version());
+                assert(snapshot->text == versionText(snapshot.version()));
+                assert(snapshot.version() >= last);
+                last = snapshot.version();
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    for (int publish = 0; publish < kPublishes; ++publish) {
+        const auto next = handle.version() + 1;
+        const auto published = handle.publish(Versioned{.version = next, .text = versionText(next)});
+        assert(published == next);
+        (void)published;
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+}
+
+}
+
+int main() {
+    const cpop::Tree tree = cpop::XMLParser::parse(buildXml());
+
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < kThreads; ++worker) {
+        workers.emplace_back(populateWorker, std::cref(tree), worker);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    snapshotStress();
+
+    std::println("Concurrent population of {} threads x {} iterations completed successfully!", kThreads, kIterations);
+    std::println("Snapshot stress of {} readers x {} publishes completed successfully!", kReaders, kPublishes);
+    return 0;
+}
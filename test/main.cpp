@@ -1,15 +1,41 @@
+#include "cpop/compose.hpp"
+#include "cpop/converter.hpp"
 #include "cpop/error.hpp"
+#include "cpop/fixed.hpp"
+#include "cpop/flat_tree.hpp"
 #include "cpop/params.hpp"
 #include "cpop/tree.hpp"
 #include "cpop/populate.hpp"
+#include "cpop/query.hpp"
+#include "cpop/shared_tree.hpp"
+#include "cpop/shm_tree.hpp"
+#include "cpop/snapshot.hpp"
+#include "cpop/static_xml.hpp"
+#include "cpop/stats.hpp"
+#include "cpop/symbols.hpp"
 #include "cpop/parsers/xml_parser.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory_resource>
 #include <optional>
 #include <print>
+#include <string_view>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace 
 {
 
@@ -198,6 +224,38 @@ void cpopXmlParseTest() {
         assert(caught_error);
     }
 
+    std::println("\nTest error path of nested structures");
+    {
+        std::string nested_xml = R"(
+            <service>
+                <server>
+                    <version>2.1</version>
+                </server>
+            </service>
+        )";
+
+        struct ServerInfo {
+          cpop::Param<std::string> name{"name"};
+          cpop::Param<double> version{"version"};
+        };
+
+        struct Service {
+          cpop::Param<ServerInfo> server{"server"};
+        };
+
+        auto tree = cpop::XMLParser::parse(nested_xml);
+        Service service;
+        bool caught_error = false;
+        try {
+            populateFromTree(service, tree, "service");
+        } catch (const cpop::PopulateError& e) {
+            caught_error = true;
+            const std::vector<std::string> expected{"service", "server", "name"};
+            assert(e.path() == expected);
+        }
+        assert(caught_error);
+    }
+
     std::println("\nTest invalid type conversion");
     {
         std::string invalid_type_xml = R"(
@@ -458,11 +516,1386 @@ void cpopTreeParseTest()
   }
 }
 
+void cpopPathQueryTest()
+{
+    std::println("\nPath query test");
+
+    std::string xml = R"(
+        <complex_config>
+            <db_list>
+                <database>
+                    <name>db1</name>
+                    <port>5432</port>
+                </database>
+                <database>
+                    <name>db2</name>
+                    <port>5433</port>
+                </database>
+            </db_list>
+            <debug>true</debug>
+        </complex_config>
+    )";
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    auto tree = cpop::XMLParser::parse(xml);
+
+    // Linear lookups
+    assert(cpop::query<int>(tree, "complex_config/db_list/database[1]/port") == 5433);
+    assert(cpop::query<int>(tree, "complex_config/db_list/database/port") == 5432);
+    assert(cpop::query<bool>(tree, "complex_config/debug"));
+    assert(!cpop::tryQuery<int>(tree, "complex_config/db_list/database[2]/port").has_value());
+    assert(!cpop::tryQuery<int>(tree, "complex_config/debug/port").has_value());
+
+    // Indexed lookups give the same answers
+    const cpop::PathIndex index(tree);
+    assert(cpop::query<std::string>(index, "complex_config/db_list/database[1]/name") == "db2");
+    assert(cpop::query<int>(index, "complex_config/db_list/database[0]/port") == 5432);
+    assert(!cpop::tryQuery<int>(index, "complex_config/db_list/database[5]/port").has_value());
+    assert(!cpop::tryQuery<int>(index, "complex_config/missing").has_value());
+
+    // tryQuery gives std::nullopt where query throws, also for malformed paths and failed population
+    assert(!cpop::tryQuery<int>(tree, "complex_config//database[x]").has_value());
+    assert(!cpop::tryQuery<int>(index, "complex_config/db_list/database[1").has_value());
+    assert(!cpop::tryQuery<Database>(tree, "complex_config/db_list").has_value());
+    assert(!cpop::tryQuery<Database>(index, "complex_config/db_list").has_value());
+
+    auto database = cpop::query<Database>(index, "complex_config/db_list/database[1]");
+    assert(database.name.value == "db2");
+    assert(database.port.value == 5433);
+
+    bool caught_error = false;
+    try {
+        cpop::query<int>(index, "complex_config/db_list/database[9]/port");
+    } catch (const cpop::PopulateError& e) {
+        caught_error = true;
+        assert(std::string(e.what()).find("Path not found") != std::string::npos);
+    }
+    assert(caught_error);
+
+    caught_error = false;
+    try {
+        cpop::query<int>(tree, "complex_config//database[x]");
+    } catch (const cpop::PopulateError& e) {
+        caught_error = true;
+        assert(std::string(e.what()).find("Malformed path") != std::string::npos);
+    }
+    assert(caught_error);
+}
+
+void cpopSnapshotTest()
+{
+    std::println("\nSnapshot publish test");
+
+    struct Config {
+      cpop::Param<int> port{"port"};
+      cpop::Param<std::string> host{"host"};
+    };
+
+    cpop::ConfigHandle<Config> handle;
+    assert(!handle.load());
+
+    const auto makeTree = [](int port) {
+        return cpop::XMLParser::parse(std::format(
+            "<config><port>{}</port><host>host{}</host></config>", port, port));
+    };
+
+    assert(cpop::publishFromTree(handle, makeTree(1), "config") == 1);
+    auto first = handle.load();
+    assert(first && first.version() == 1 && first->port.value == 1);
+
+    // A failed reload leaves the current version in place
+    try {
+        cpop::publishFromTree(handle, cpop::XMLParser::parse("<config><host>x</host></config>"), "config");
+        assert(false && "Should have thrown exception for missing required field");
+    } catch (const cpop::PopulateError&) {}
+    assert(handle.version() == 1);
+
+    constexpr int kReloads = 200;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&handle, &done] {
+            std::uint64_t last_version = 0;
+            while (!done.load()) {
+                auto snapshot = handle.load();
+                assert(snapshot.version() >= last_version);
+                assert(snapshot->host.value == std::format("host{}", snapshot->port.value));
+                last_version = snapshot.version();
+            }
+        });
+    }
+
+    for (int port = 2; port <= kReloads; ++port) {
+        Config config;
+        cpop::populateFromTree(config, makeTree(port), "config");
+        handle.publish(std::move(config));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    // The pinned first version survived every reload
+    assert(first->port.value == 1 && first->host.value == "host1");
+    assert(handle.load()->port.value == kReloads);
+
+    // Pinning more versions than there are free slots adds slots instead of stalling the publisher
+    cpop::ConfigHandle<int> counter(0);
+    std::vector<cpop::Snapshot<int>> pinned;
+    for (int i = 1; i < static_cast<int>(cpop::ConfigHandle<int>::kMaxSlots); ++i) {
+        pinned.push_back(counter.load());
+        counter.publish(i);
+    }
+    pinned.push_back(counter.load());
+    for (std::size_t i = 0; i < pinned.size(); ++i) {
+        assert(*pinned[i] == static_cast<int>(i) && pinned[i].version() == i + 1);
+    }
+
+    // With every slot pinned a publish waits until a reader lets go of one
+    std::jthread publisher([&counter] { counter.publish(-1); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(*counter.load() == static_cast<int>(pinned.size()) - 1);
+    pinned[pinned.size() / 2] = {};
+    publisher.join();
+    assert(*counter.load() == -1 && *pinned.front() == 0);
+}
+
+void cpopStatsTest()
+{
+    std::println("\nStats test");
+
+    std::string xml = R"(
+        <config>
+            <port>8080</port>
+            <host>localhost</host>
+            <debug>maybe</debug>
+            <db_list>
+                <database><name>db1</name><port>5432</port></database>
+                <database><name>db2</name><port>5433</port></database>
+            </db_list>
+        </config>
+    )";
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Config {
+      cpop::Param<int> port{"port"};
+      cpop::Param<std::string> host{"host"};
+      cpop::OptParam<bool> debug{"debug"};
+      cpop::Multiple<Database> databases{"db_list", "database"};
+    };
+
+    cpop::Stats stats;
+    Config config;
+    {
+        cpop::StatsScope scope(stats);
+        auto tree = cpop::XMLParser::parse(xml);
+        cpop::populateFromTree(config, tree, "config");
+    }
+
+    // Nothing is recorded outside of a scope
+    auto tree = cpop::XMLParser::parse(xml);
+    cpop::populateFromTree(config, tree, "config");
+
+    if constexpr (cpop::Stats::enabled) {
+        assert(stats.bytes == xml.size());
+        assert(stats.nodes == 11);
+        assert(stats.conversions.signed_integer == 3);
+        assert(stats.conversions.string == 3);
+        assert(stats.conversions.failed == 1);
+        assert(stats.conversions.boolean == 0);
+        assert(stats.warnings == 1);
+        assert(stats.lookup_comparisons > 0);
+        assert(stats.parse_time.count() > 0);
+        assert(stats.populate_time >= stats.convert_time);
+        assert(stats.read_time.count() == 0);
+    } else {
+        assert(stats.nodes == 0);
+    }
+}
+
+void cpopSymbolTest()
+{
+    std::println("\nInterned keys test");
+
+    auto& symbols = cpop::SymbolTable::global();
+    const auto port = symbols.intern("port");
+    assert(port != cpop::kNoSymbol);
+    assert(symbols.intern("port") == port);
+    assert(symbols.find("port") == port);
+    assert(symbols.name(port) == "port");
+    assert(symbols.find("never_interned_key") == cpop::kNoSymbol);
+
+    auto tree = cpop::XMLParser::parse("<config><port>8080</port><host>localhost</host></config>");
+    const auto& config = std::get<std::vector<cpop::Element>>(tree[0].content);
+    assert(config[0].symbol == port);
+    assert(config[1].symbol == symbols.find("host"));
+
+    struct Config {
+      cpop::Param<int> port{"port"};
+      cpop::Param<std::string> host{"host"};
+      cpop::OptParam<bool> debug{"debug"};
+    };
+
+    // Hand built elements without symbols still match by key string
+    auto& children = std::get<std::vector<cpop::Element>>(tree[0].content);
+    children.push_back({.key = "debug", .content = cpop::Node{"true"}});
+
+    Config populated;
+    cpop::populateFromTree(populated, tree, "config");
+    assert(populated.port.value == 8080);
+    assert(populated.host.value == "localhost");
+    assert(populated.debug.value.has_value() && populated.debug.value.value());
+
+    // A key that differs from the one seen the first time the type was populated
+    Config renamed;
+    renamed.host.key = "port";
+    cpop::populateFromTree(renamed, children);
+    assert(renamed.host.value == "8080");
+}
+
+void cpopMovePopulateTest()
+{
+    std::println("\nMove populate test");
+
+    const std::string certificate(4096, 'c');
+    const std::string xml = std::format(R"(
+        <config>
+            <certificate>{}</certificate>
+            <name>server</name>
+            <alias>{}</alias>
+            <db_list>
+                <database><name>db1</name><port>5432</port></database>
+            </db_list>
+        </config>
+    )", certificate, certificate);
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Config {
+      cpop::Param<std::string> certificate{"certificate"};
+      cpop::Param<std::string> name{"name"};
+      cpop::OptParam<std::string> alias{"alias"};
+      cpop::Multiple<Database> databases{"db_list", "database"};
+    };
+
+    // Moving out of a tree gives the same result as copying from it
+    auto tree = cpop::XMLParser::parse(xml);
+    Config copied;
+    cpop::populateFromTree(copied, tree, "config");
+
+    const auto* certificate_elem = cpop::findPath(tree, "config/certificate");
+    assert(certificate_elem != nullptr);
+    const char* certificate_data = std::get<cpop::Node>(certificate_elem->content).value.data();
+
+    Config moved;
+    cpop::populateFromTree(moved, std::move(tree), "config");
+    assert(moved.certificate.value == certificate);
+    assert(moved.certificate.value == copied.certificate.value);
+    assert(moved.name.value == "server");
+    assert(moved.alias.value.has_value() && moved.alias.value.value() == certificate);
+    assert(moved.databases.values.size() == 1);
+    assert(moved.databases.values[0].name.value == "db1");
+
+    // The strings were moved out of the tree rather than copied, and the tree was torn down afterwards
+    assert(moved.certificate.value.data() == certificate_data);
+    assert(tree.empty()); // NOLINT(bugprone-use-after-move)
+
+    Config temporary;
+    cpop::populateFromTree(temporary, cpop::XMLParser::parse(xml), "config");
+    assert(temporary.certificate.value == certificate);
+
+    // The top level overload populates the given object in place, so keys set on it are used
+    Config renamed;
+    renamed.name.key = "alias";
+    cpop::populateFromTree(renamed, cpop::XMLParser::parse(xml), "config");
+    assert(renamed.name.value == certificate);
+    assert(renamed.alias.value == certificate);
+
+    // Fields that read the same element each get its value, the moving overloads copy it to all but none
+    struct Timeout {
+      cpop::Param<std::string> raw{"timeout"};
+      cpop::Param<int> timeout{"timeout"};
+    };
+    Timeout timeout;
+    cpop::populateFromTree(timeout, cpop::XMLParser::parse("<config><timeout>30</timeout></config>"), "config");
+    assert(timeout.raw.value == "30" && timeout.timeout.value == 30);
+
+    // Errors from the rvalue overloads report the same paths
+    bool caught_error = false;
+    try {
+        Config missing;
+        cpop::populateFromTree(missing, cpop::XMLParser::parse("<config><name>x</name></config>"), "config");
+    } catch (const cpop::PopulateError& e) {
+        caught_error = true;
+        const std::vector<std::string> expected{"config", "certificate"};
+        assert(e.path() == expected);
+    }
+    assert(caught_error);
+}
+
+enum class LogLevel { Debug, Info, Error };
+
+}
+
+template<>
+struct cpop::EnumNames<LogLevel> {
+    static constexpr std::array<std::pair<std::string_view, LogLevel>, 3> names{{
+        {"debug", LogLevel::Debug}, {"info", LogLevel::Info}, {"error", LogLevel::Error}}};
+};
+
+namespace
+{
+
+struct Endpoint {
+    std::string host;
+    int port = 0;
+};
+
+}
+
+// User types plug in through the same customization point as the built in converters
+template<>
+struct cpop::Converter<Endpoint> {
+    static std::optional<Endpoint> fromString(std::string_view value) {
+        const auto colon = value.find(':');
+        if (colon == std::string_view::npos) {
+            return std::nullopt;
+        }
+        auto port = cpop::detail::parseNumber<int>(value.substr(colon + 1));
+        if (!port) {
+            return std::nullopt;
+        }
+        return Endpoint{.host = std::string(value.substr(0, colon)), .port = *port};
+    }
+};
+
+namespace
+{
+
+void cpopConverterTest()
+{
+    using namespace std::chrono_literals;
+    std::println("\nConverter test");
+
+    std::string xml = R"(
+        <config>
+            <timeout>250ms</timeout>
+            <interval>1.5 s</interval>
+            <cache_size>64MiB</cache_size>
+            <upload_limit>1.5GB</upload_limit>
+            <level>Info</level>
+            <endpoint>localhost:8080</endpoint>
+            <retry_delays>
+                <delay>10ms</delay>
+                <delay>2s</delay>
+                <delay>soon</delay>
+            </retry_delays>
+            <bad_timeout>1500us</bad_timeout>
+        </config>
+    )";
+
+    struct Config {
+      cpop::Param<std::chrono::milliseconds> timeout{"timeout"};
+      cpop::Param<std::chrono::milliseconds> interval{"interval"};
+      cpop::Param<cpop::ByteSize> cache_size{"cache_size"};
+      cpop::Param<cpop::ByteSize> upload_limit{"upload_limit"};
+      cpop::Param<LogLevel> level{"level"};
+      cpop::Param<Endpoint> endpoint{"endpoint"};
+      cpop::Multiple<std::chrono::milliseconds> retry_delays{"retry_delays", "delay"};
+      cpop::OptParam<std::chrono::milliseconds> bad_timeout{"bad_timeout"};
+    };
+
+    Config config;
+    cpop::populateFromTree(config, cpop::XMLParser::parse(xml), "config");
+
+    assert(config.timeout.value == 250ms);
+    assert(config.interval.value == 1500ms);
+    assert(config.cache_size.value.bytes == 64ULL * 1024 * 1024);
+    assert(config.upload_limit.value.bytes == 1'500'000'000ULL);
+    assert(config.level.value == LogLevel::Info);
+    assert(config.endpoint.value.host == "localhost" && config.endpoint.value.port == 8080);
+    assert(config.retry_delays.values.size() == 2);
+    assert(config.retry_delays.values[0] == 10ms && config.retry_delays.values[1] == 2000ms);
+    assert(!config.bad_timeout.value.has_value()); // 1.5ms is not a whole number of milliseconds
+
+    using Convert = cpop::detail::TypeConverter;
+    assert(Convert::tryConvert<std::chrono::seconds>("2min") == std::chrono::seconds{120});
+    assert(Convert::tryConvert<std::chrono::nanoseconds>("3us") == std::chrono::nanoseconds{3000});
+    assert(Convert::tryConvert<std::chrono::duration<double>>("250ms") == std::chrono::duration<double>{0.25});
+    assert(!Convert::tryConvert<std::chrono::seconds>("10").has_value());
+    assert(!Convert::tryConvert<std::chrono::seconds>("10 parsecs").has_value());
+    assert(!Convert::tryConvert<std::chrono::nanoseconds>("1000000d").has_value()); // overflows
+    assert(Convert::tryConvert<cpop::ByteSize>("512") == cpop::ByteSize{512});
+    assert(Convert::tryConvert<cpop::ByteSize>("4kb") == cpop::ByteSize{4000});
+    assert(Convert::tryConvert<cpop::ByteSize>("1 TiB") == cpop::ByteSize{1ULL << 40});
+    assert(!Convert::tryConvert<cpop::ByteSize>("-1KB").has_value());
+    assert(!Convert::tryConvert<cpop::ByteSize>("0.5B").has_value());
+    assert(!Convert::tryConvert<LogLevel>("verbose").has_value());
+
+    bool caught_error = false;
+    try {
+        Config invalid;
+        cpop::populateFromTree(invalid, cpop::XMLParser::parse("<config><timeout>soon</timeout></config>"), "config");
+    } catch (const cpop::PopulateError& e) {
+        caught_error = true;
+        assert(std::string(e.what()).find("Failed to convert value") != std::string::npos);
+    }
+    assert(caught_error);
+}
+
+void cpopComposeTest()
+{
+    std::println("\nCompose test");
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Server {
+      cpop::Param<std::string> host{"host"};
+      cpop::Param<int> workers{"workers"};
+      cpop::OptParam<bool> debug{"debug"};
+    };
+
+    struct Config {
+      cpop::Param<Server> server{"server"};
+      cpop::Multiple<Database> databases{"db_list", "database"};
+    };
+
+    const auto dir = std::filesystem::temp_directory_path() / "cpop_compose_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const auto write = [&](const std::string& name, const std::string& content) {
+        std::ofstream(dir / name) << content;
+        return dir / name;
+    };
+
+    write("databases.xml", R"(
+        <config>
+            <server><host>included.host</host></server>
+            <db_list>
+                <database><name>primary</name><port>5432</port></database>
+            </db_list>
+        </config>
+    )");
+    const auto base = write("base.xml", R"(
+        <config>
+            <server><host>0.0.0.0</host><workers>4</workers></server>
+            <include>databases.xml</include>
+        </config>
+    )");
+    const auto region = write("region.xml", R"(
+        <config>
+            <server><workers>8</workers></server>
+            <db_list>
+                <database><name>replica</name><port>5433</port></database>
+            </db_list>
+        </config>
+    )");
+    const auto host = write("host.xml", "<config><server><debug>true</debug></server></config>");
+
+    const auto rules = cpop::mergeRulesFor<Config>();
+    assert(rules.list_keys.contains("db_list"));
+
+    cpop::FragmentCache cache;
+    const std::vector<std::filesystem::path> layers{base, region, host};
+    auto tree = cpop::composeFiles(cache, layers, rules);
+
+    Config config;
+    cpop::populateFromTree(config, *tree, "config");
+    assert(config.server.value.host.value == "0.0.0.0"); // the including file overrides what it includes
+    assert(config.server.value.workers.value == 8);
+    assert(config.server.value.debug.value == true);
+    assert(config.databases.values.size() == 2);
+    assert(config.databases.values[0].name.value == "primary");
+    assert(config.databases.values[1].name.value == "replica");
+    assert(cache.parses() == 4);
+
+    // Loading fragments from several threads parses each changed fragment once, whichever thread gets to it first
+    write("region.xml", R"(
+        <config>
+            <server><workers>8</workers></server>
+            <db_list>
+                <database><name>replica</name><port>5433</port></database>
+            </db_list>
+        </config>
+    )"); // same content, so a new modification time only causes a re-read
+    {
+        std::vector<std::jthread> loaders;
+        for (int i = 0; i < 4; ++i) {
+            loaders.emplace_back([&] {
+                for (const auto& layer : layers) {
+                    assert(cache.load(layer) != nullptr);
+                }
+            });
+        }
+    }
+    assert(cache.parses() == 4);
+
+    // Unchanged files give the same composed tree, without merging again
+    assert(cpop::composeFiles(cache, layers, rules) == tree);
+    assert(cpop::composeFiles(cache, layers) != tree);
+
+    // Only the changed host file is parsed again
+    write("host.xml", "<config><server><debug>false</debug><workers>16</workers></server></config>");
+    const auto previous = tree;
+    tree = cpop::composeFiles(cache, layers, rules);
+    assert(cache.parses() == 5);
+    assert(tree != previous);
+    // An earlier composition stays intact for whoever still holds it
+    assert(std::get<cpop::Node>(cpop::findPath(*previous, "config/server/workers")->content).value == "8");
+
+    Config updated;
+    cpop::populateFromTree(updated, *tree, "config");
+    assert(updated.server.value.workers.value == 16);
+    assert(updated.server.value.debug.value == false);
+    assert(updated.databases.values.size() == 2);
+
+    // Without list rules a list merges like any other nested element
+    cpop::Tree merged = cpop::XMLParser::parse("<config><db_list><database>a</database></db_list></config>");
+    cpop::mergeTree(merged, cpop::XMLParser::parse("<config><db_list><database>b</database></db_list></config>"));
+    assert(std::get<cpop::Node>(cpop::findPath(merged, "config/db_list/database")->content).value == "b");
+
+    // A nested include is part of the level that holds it, which in turn overrides what its parent includes
+    write("server_defaults.xml", "<config><host>defaults.host</host><workers>2</workers></config>");
+    write("outer.xml", "<config><server><host>outer.host</host><workers>3</workers><debug>true</debug></server></config>");
+    const auto nested = write("nested.xml",
+        "<config><include>outer.xml</include><server><include>server_defaults.xml</include><workers>6</workers></server></config>");
+    struct ServerOnly {
+      cpop::Param<Server> server{"server"};
+    };
+    ServerOnly server_only;
+    cpop::populateFromTree(server_only, *cpop::composeFiles(cache, {nested}), "config");
+    const auto& server = server_only.server.value;
+    assert(server.host.value == "defaults.host" && server.workers.value == 6 && server.debug.value == true);
+
+    write("cycle.xml", "<config><include>cycle.xml</include></config>");
+    bool caught_cycle = false;
+    try {
+        cpop::composeFiles(cache, {dir / "cycle.xml"});
+    } catch (const std::exception& e) {
+        caught_cycle = std::string(e.what()).find("include cycle") != std::string::npos;
+    }
+    assert(caught_cycle);
+
+    std::filesystem::remove_all(dir);
+}
+
+inline constexpr std::string_view kStaticDefaultsXml = R"(<?xml version="1.0"?>
+    <!-- built in defaults -->
+    <config version="2">
+        <server>
+            <host>0.0.0.0</host>
+            <port>8080</port>
+        </server>
+        <greeting>hello &amp; welcome &#x21;</greeting>
+        <empty/>
+        <db_list>
+            <database><name>primary</name><port>5432</port></database>
+            <database><name><![CDATA[<replica>]]></name><port>5433</port></database>
+        </db_list>
+    </config>
+)";
+
+void cpopStaticXmlTest()
+{
+    std::println("\nStatic XML test");
+
+    constexpr auto defaults = cpop::staticXml<kStaticDefaultsXml>;
+    static_assert(defaults.key(0) == "<xmlcomment>");
+    static_assert(defaults.value(0) == " built in defaults ");
+    static_assert(defaults.key(1) == "config");
+    static_assert(defaults.key(2) == "<xmlattr>" && defaults.key(3) == "version" && defaults.value(3) == "2");
+
+    struct Server {
+      cpop::Param<std::string> host{"host"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Config {
+      cpop::Param<Server> server{"server"};
+      cpop::Param<std::string> greeting{"greeting"};
+      cpop::Multiple<Database> databases{"db_list", "database"};
+    };
+
+    Config config;
+    cpop::populateFromStatic(config, defaults, "config");
+    assert(config.server.value.host.value == "0.0.0.0");
+    assert(config.server.value.port.value == 8080);
+    assert(config.greeting.value == "hello & welcome !");
+    assert(config.databases.values.size() == 2);
+    assert(config.databases.values[1].name.value == "<replica>");
+
+    // The compile time tree matches what the runtime parser produces
+    Config parsed;
+    cpop::populateFromTree(parsed, cpop::XMLParser::parse(std::string(kStaticDefaultsXml)), "config");
+    assert(parsed.greeting.value == config.greeting.value);
+    assert(parsed.databases.values[1].name.value == config.databases.values[1].name.value);
+
+    // At runtime the same reader reports malformed documents as ParseError
+    for (const std::string_view malformed : {"<config><port>1</config>", "<config>&unknown;</config>", "<config"}) {
+        bool caught_error = false;
+        try {
+            cpop::detail::StaticTreeBuilder builder;
+            cpop::detail::readXml(malformed, builder);
+        } catch (const cpop::ParseError&) {
+            caught_error = true;
+        }
+        assert(caught_error);
+    }
+}
+
+struct Chain {
+  cpop::Param<int> id{"id"};
+  cpop::Multiple<Chain> next{"next", "chain"};
+};
+
+void cpopDeepDocumentTest()
+{
+    std::println("\nDeep document test");
+
+    // Far deeper than a recursive parser or destructor could handle on a default sized stack
+    constexpr std::size_t depth = 200'000;
+    std::string xml;
+    for (std::size_t i = 0; i < depth; ++i) {
+        xml += "<level>";
+    }
+    xml += "bottom";
+    for (std::size_t i = 0; i < depth; ++i) {
+        xml += "</level>";
+    }
+
+    auto tree = cpop::XMLParser::parse(xml);
+    std::size_t levels = 0;
+    const cpop::Element* elem = &tree.front();
+    while (const auto* children = std::get_if<std::vector<cpop::Element>>(&elem->content)) {
+        ++levels;
+        elem = &children->front();
+    }
+    assert(levels + 1 == depth);
+    assert(std::get<cpop::Node>(elem->content).value == "bottom");
+
+    const cpop::PathIndex index(tree);
+    assert(index.find("level/level/level") != nullptr);
+    cpop::destroyTree(std::move(tree));
+    assert(tree.empty()); // NOLINT(bugprone-use-after-move)
+
+    // A deep temporary given to populateFromTree is torn down without recursion too
+    struct Shallow {
+      cpop::OptParam<std::string> name{"name"};
+    };
+    Shallow shallow;
+    cpop::populateFromTree(shallow, cpop::XMLParser::parse(xml), "level");
+    assert(!shallow.name.value.has_value());
+
+    // A deep document that is cut off is torn down without recursion as well
+    bool caught_error = false;
+    try {
+        cpop::XMLParser::parse(std::string_view(xml).substr(0, std::string_view("<level>").size() * depth / 2));
+    } catch (const cpop::ParseError& e) {
+        caught_error = true;
+        assert(std::string(e.what()).find("unclosed element") != std::string::npos);
+    }
+    assert(caught_error);
+
+    // Population of a recursive type fails at the nesting limit instead of exhausting the stack, even below list items
+    std::string chain_xml;
+    constexpr std::size_t chain_depth = 1000;
+    for (std::size_t i = 0; i < chain_depth; ++i) {
+        chain_xml += std::format("<chain><id>{}</id><next>", i);
+    }
+    for (std::size_t i = 0; i < chain_depth; ++i) {
+        chain_xml += "</next></chain>";
+    }
+
+    auto chain_tree = cpop::XMLParser::parse(chain_xml);
+    Chain chain;
+    caught_error = false;
+    try {
+        cpop::populateFromTree(chain, chain_tree, "chain");
+    } catch (const cpop::NestingDepthError& e) {
+        caught_error = true;
+        assert(e.path().size() == 2 * cpop::detail::kMaxPopulateDepth + 1); // "chain" and a "next", "chain" pair per level
+        assert(std::string_view(e.what()).find("Maximum nesting depth exceeded") != std::string_view::npos);
+    }
+    assert(caught_error);
+    cpop::destroyTree(std::move(chain_tree));
+}
+
+void cpopSharedTreeTest()
+{
+    std::println("\nShared tree test");
+
+    constexpr int shard_count = 50;
+    std::string xml = "<config><shards>";
+    for (int i = 0; i < shard_count; ++i) {
+        xml += std::format(R"(<shard id="{}"><database><host>db.internal</host><port>5432</port><pool>16</pool></database></shard>)", i % 2);
+    }
+    xml += "</shards></config>";
+
+    cpop::NodePool pool;
+    const auto shared = cpop::XMLParser::parseShared(xml, pool);
+
+    // Identical shards are one node: two distinct shards, one database, and far fewer nodes than elements
+    const auto& shards = shared.front()->children.front()->children;
+    assert(shards.size() == shard_count);
+    assert(shards[0] == shards[2] && shards[1] == shards[3] && shards[0] != shards[1]);
+    assert(shards[0]->children[1] == shards[1]->children[1]);
+    assert(pool.size() < 20);
+
+    // Interning a parsed Tree into the same pool yields the same nodes
+    const auto tree = cpop::XMLParser::parse(xml);
+    assert(pool.intern(tree) == shared);
+
+    struct Database {
+      cpop::Param<std::string> host{"host"};
+      cpop::Param<int> port{"port"};
+      cpop::Param<int> pool{"pool"};
+    };
+
+    struct Shard {
+      cpop::Param<Database> database{"database"};
+    };
+
+    struct Config {
+      cpop::Multiple<Shard> shards{"shards", "shard"};
+    };
+
+    Config expected;
+    cpop::populateFromTree(expected, tree, "config");
+
+    Config uncached;
+    cpop::populateFromTree(uncached, shared, "config");
+
+    cpop::PopulateCache cache;
+    Config cached;
+    cpop::populateFromTree(cached, shared, "config", cache);
+
+    for (const auto* config : {&uncached, &cached}) {
+        assert(config->shards.values.size() == expected.shards.values.size());
+        for (std::size_t i = 0; i < expected.shards.values.size(); ++i) {
+            const auto& db = config->shards.values[i].database.value;
+            const auto& expected_db = expected.shards.values[i].database.value;
+            assert(db.host.value == expected_db.host.value);
+            assert(db.port.value == expected_db.port.value && db.pool.value == expected_db.pool.value);
+        }
+    }
+    // Of the two distinct shards only the first populates the shared database, every other shard is a cache hit
+    assert(cache.hits() == shard_count - 1);
+
+    bool caught_error = false;
+    try {
+        struct Missing {
+          cpop::Param<int> missing{"missing"};
+        };
+        Missing missing;
+        cpop::populateFromTree(missing, shared, "config", cache);
+    } catch (const cpop::PopulateError& e) {
+        caught_error = true;
+        const std::vector<std::string> expected_path{"config", "missing"};
+        assert(e.path() == expected_path);
+    }
+    assert(caught_error);
+}
+
+struct Section {
+  cpop::Param<std::string> title{"title"};
+  cpop::Multiple<Section> sections{"sections", "section"};
+  cpop::OptParam<int> weight{"weight"};
+};
+
+void cpopPopulatePlanTest()
+{
+    std::println("\nPopulate plan test");
+
+    struct Tenant {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+      cpop::OptParam<std::string> region{"region"};
+      cpop::Multiple<std::string> tags{"tags", "tag"};
+    };
+
+    const auto populate = [](std::string_view xml, Tenant& tenant) {
+        const auto tree = cpop::XMLParser::parse(xml);
+        cpop::Stats stats;
+        const cpop::StatsScope scope(stats);
+        cpop::populateFromTree(tenant, tree, "tenant");
+        return stats.planned_lookups;
+    };
+
+    // Same shape: after the first population every field is taken from its recorded position
+    for (int i = 0; i < 3; ++i) {
+        Tenant tenant;
+        const auto planned = populate(std::format(
+            "<tenant><name>tenant{0}</name><region>eu</region><port>{0}</port><tags><tag>a</tag></tags></tenant>", i), tenant);
+        assert(planned == (i == 0 ? 0U : 4U));
+        assert(tenant.name.value == std::format("tenant{}", i));
+        assert(tenant.port.value == i);
+        assert(tenant.region.value == "eu");
+        assert(tenant.tags.values.size() == 1);
+    }
+
+    // Different shapes fall back to searching and give the same results
+    const std::string_view reordered_xml = "<tenant><port>7</port><name>r</name><tags/><region>us</region></tenant>";
+    Tenant reordered;
+    assert(populate(reordered_xml, reordered) == 0);
+    assert(reordered.name.value == "r" && reordered.port.value == 7 && reordered.region.value == "us");
+
+    Tenant duplicate;
+    populate("<tenant><name>first</name><name>second</name><port>1</port></tenant>", duplicate);
+    assert(duplicate.name.value == "first" && !duplicate.region.value.has_value());
+
+    // A repeated key is not taken from a recorded position, even in a level of the size that was recorded
+    Tenant before_duplicate;
+    populate("<tenant><x/><name>A</name><port>1</port></tenant>", before_duplicate);
+    Tenant same_size_duplicate;
+    populate("<tenant><name>B</name><name>C</name><port>1</port></tenant>", same_size_duplicate);
+    assert(same_size_duplicate.name.value == "B");
+
+    // A key changed on the object is searched for even when the shape matches
+    Tenant recorded;
+    assert(populate(reordered_xml, recorded) == 0);
+    Tenant renamed;
+    renamed.name.key = "region";
+    assert(populate(reordered_xml, renamed) == 3);
+    assert(renamed.name.value == "us");
+
+    // Levels of a recursive type nested in a level that follows the plan search instead of re-recording it
+    Section flat_section;
+    cpop::populateFromTree(flat_section, cpop::XMLParser::parse(
+        "<section><title>a</title><sections/><weight>1</weight></section>"), "section");
+    Section nested_section;
+    cpop::populateFromTree(nested_section, cpop::XMLParser::parse(
+        "<section><title>top</title><sections><section><weight>2</weight><title>inner</title><sections/></section>"
+        "</sections><weight>3</weight></section>"), "section");
+    assert(nested_section.title.value == "top" && nested_section.weight.value == 3);
+    assert(nested_section.sections.values.size() == 1);
+    assert(nested_section.sections.values[0].title.value == "inner" && nested_section.sections.values[0].weight.value == 2);
+}
+
+void cpopFixedCapacityTest()
+{
+    std::println("\nFixed capacity test");
+
+    struct Realtime {
+      cpop::Param<cpop::FixedString<16>> name{"name"};
+      cpop::Multiple<int, cpop::InplaceVector<int, 4>> ports{"ports", "port"};
+    };
+
+    Realtime realtime;
+    cpop::populateFromTree(realtime, cpop::XMLParser::parse(
+        "<realtime><name>mixer</name><ports><port>1</port><port>2</port></ports></realtime>"), "realtime");
+    assert(realtime.name.value == "mixer");
+    assert(realtime.ports.values.size() == 2 && realtime.ports.values[1] == 2);
+
+    // Populating again replaces the list rather than appending to it
+    cpop::populateFromTree(realtime, cpop::XMLParser::parse(
+        "<realtime><name>sampler</name><ports><port>3</port></ports></realtime>"), "realtime");
+    assert(realtime.name.value == "sampler");
+    assert(realtime.ports.values.size() == 1 && realtime.ports.values[0] == 3);
+
+    try {
+        cpop::populateFromTree(realtime, cpop::XMLParser::parse(
+            "<realtime><name>a_name_longer_than_sixteen</name><ports/></realtime>"), "realtime");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert(std::string_view(e.what()).find("exceeds the capacity of 16 characters") != std::string_view::npos);
+        assert((e.path() == std::vector<std::string>{"realtime", "name"}));
+    }
+
+    try {
+        cpop::populateFromTree(realtime, cpop::XMLParser::parse(
+            "<realtime><name>a</name><ports><port>1</port><port>2</port><port>3</port><port>4</port><port>5</port></ports></realtime>"),
+            "realtime");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert(std::string_view(e.what()).find("List exceeds the capacity of 4 items") != std::string_view::npos);
+        assert((e.path() == std::vector<std::string>{"realtime", "ports", "port"}));
+    }
+
+    // Items that fail conversion take no room in the list
+    cpop::populateFromTree(realtime, cpop::XMLParser::parse(
+        "<realtime><name>a</name><ports><port>1</port><port>2</port><port>3</port><port>4</port><port>x</port></ports></realtime>"),
+        "realtime");
+    assert(realtime.ports.values.size() == 4 && realtime.ports.values[0] == 1 && realtime.ports.values[3] == 4);
+
+    // Allocator-aware output types draw their memory from the resource they were constructed with
+    static std::array<std::byte, 4096> buffer{};
+    static std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+    struct Pooled {
+      cpop::Param<std::pmr::string> path{"path", &resource};
+      cpop::Multiple<std::pmr::string, std::pmr::vector<std::pmr::string>> hosts{"hosts", "host", &resource};
+    };
+
+    Pooled pooled;
+    const auto pooled_tree = cpop::XMLParser::parse(
+        "<pooled><path>/a/path/that/does/not/fit/in/small/string/storage</path>"
+        "<hosts><host>first.host.that.does.not.fit.in.small/string/storage</host><host>b</host></hosts></pooled>");
+    cpop::populateFromTree(pooled, pooled_tree, "pooled");
+    assert(pooled.path.value == "/a/path/that/does/not/fit/in/small/string/storage");
+    assert(pooled.hosts.values.size() == 2 && pooled.hosts.values[1] == "b");
+    assert(pooled.path.value.get_allocator().resource() == &resource);
+    assert(pooled.hosts.values[0].get_allocator().resource() == &resource);
+}
+
+void cpopSourceLocationTest()
+{
+    std::println("\nSource location test");
+
+    assert((cpop::locate("ab\ncd\nef", 4) == cpop::SourceLocation{.line = 2, .column = 2}));
+    assert((cpop::locate("ab", 0) == cpop::SourceLocation{.line = 1, .column = 1}));
+    assert(!cpop::locate("ab", 3).has_value());
+    assert(!cpop::locate("ab", cpop::kNoOffset).has_value());
+
+    try {
+        (void)cpop::XMLParser::parse("<config>\n  <port>1</host>\n</config>");
+        assert(false);
+    } catch (const cpop::ParseError& e) {
+        assert((e.location("<config>\n  <port>1</host>\n</config>") == cpop::SourceLocation{.line = 2, .column = 10}));
+    }
+
+#ifdef CPOP_NO_SOURCE_OFFSETS
+    std::println("Source offsets are not recorded, skipping");
+#else
+    struct Server {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Config {
+      cpop::Param<Server> server{"server"};
+      cpop::Multiple<int> ports{"ports", "port"};
+    };
+
+    const std::string xml =
+        "<config>\n"
+        "  <server>\n"
+        "    <name>main</name>\n"
+        "    <port>eighty</port>\n"
+        "  </server>\n"
+        "</config>\n";
+    const auto tree = cpop::XMLParser::parse(xml);
+    assert(tree[0].offset.get() == 0);
+
+    // The offending element is located
+    try {
+        Config config;
+        cpop::populateFromTree(config, tree, "config");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert((e.path() == std::vector<std::string>{"config", "server", "port"}));
+        assert((e.location(xml) == cpop::SourceLocation{.line = 4, .column = 5}));
+        assert(std::string_view(e.what()).find(std::format("(offset {})", e.offset())) != std::string_view::npos);
+    }
+
+    // A missing key is located at the element that should have contained it
+    try {
+        Server server;
+        cpop::populateFromTree(server, cpop::XMLParser::parse("<config>\n  <name>a</name>\n</config>"), "config");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert((e.path() == std::vector<std::string>{"config", "port"}));
+        assert(e.offset() == 0);
+    }
+
+    // Attributes are located at their name, query errors at the element queried
+    const std::string attributes_xml = "<config>\n  <server port=\"x\"/>\n</config>";
+    const auto attributes = cpop::XMLParser::parse(attributes_xml);
+    try {
+        (void)cpop::query<int>(attributes, "config/server/<xmlattr>/port");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert((e.location(attributes_xml) == cpop::SourceLocation{.line = 2, .column = 11}));
+    }
+
+    // Hand built elements have no offset
+    const cpop::Element built{.key = "port", .content = cpop::Node{"1"}};
+    assert(built.offset.get() == cpop::kNoOffset);
+#endif
+}
+
+
+// Same keys, values and offsets
+bool sameTree(const cpop::Tree& lhs, const cpop::Tree& rhs) {
+    return std::ranges::equal(lhs, rhs, [](const cpop::Element& a, const cpop::Element& b) {
+        if (a.key != b.key || a.symbol != b.symbol || a.offset.get() != b.offset.get()
+            || a.content.index() != b.content.index()) {
+            return false;
+        }
+        if (const auto* children = std::get_if<std::vector<cpop::Element>>(&a.content)) {
+            return sameTree(*children, std::get<std::vector<cpop::Element>>(b.content));
+        }
+        return std::get<cpop::Node>(a.content).value == std::get<cpop::Node>(b.content).value;
+    });
+}
+
+void cpopParallelParseTest()
+{
+    std::println("\nParallel parse test");
+
+    std::string records = "<?xml version=\"1.0\"?>\n<!-- export -->\n<export version=\"2\">\n  <header><count>2000</count></header>\n  <records>\n";
+    for (int i = 0; i < 2000; ++i) {
+        records += std::format("    <record id=\"{0}\"><name>r&amp;{0}</name><note><![CDATA[<b>{0}</b>]]></note><empty/></record>\n", i);
+        if (i % 500 == 0) {
+            records += "    <!-- checkpoint -->\n";
+        }
+    }
+    records += "  </records>\n  <footer>done</footer>\n</export>\n<!-- end -->\n";
+
+    const auto expected = cpop::XMLParser::parse(records);
+    const cpop::ParallelParseOptions root_split{.threads = 4, .split_path = {}, .min_chunk_bytes = 512};
+    const cpop::ParallelParseOptions records_split{.threads = 4, .split_path = {"records"}, .min_chunk_bytes = 512};
+
+    // Parses in parallel, checks the result against parse and returns the number of chunks, 0 if not split
+    const auto parallelChunks = [](std::string_view xml, const cpop::ParallelParseOptions& options) {
+        cpop::Stats parallel_stats;
+        {
+            const cpop::StatsScope scope(parallel_stats);
+            assert(sameTree(cpop::XMLParser::parseParallel(xml, options), cpop::XMLParser::parse(xml)));
+        }
+        return parallel_stats.parallel_chunks;
+    };
+
+    // CDATA within the records does not keep them from being split
+    cpop::Stats stats;
+    {
+        const cpop::StatsScope scope(stats);
+        assert(sameTree(cpop::XMLParser::parseParallel(records, records_split), expected));
+    }
+    assert(stats.parallel_chunks > 4);
+    cpop::Stats sequential_stats;
+    {
+        const cpop::StatsScope scope(sequential_stats);
+        (void)cpop::XMLParser::parse(records);
+    }
+    assert(stats.nodes == sequential_stats.nodes);
+
+    assert(parallelChunks(records, root_split) > 1);
+    assert(parallelChunks(records, {.threads = 1, .split_path = {"records"}, .min_chunk_bytes = 512}) == 0);
+    assert(sameTree(cpop::XMLParser::parseParallel(records), expected));
+
+    // Documents that cannot be split are parsed as a whole
+    for (const std::string_view xml : {"<a>text<b>1</b><b>2</b></a>", "<a><![CDATA[text]]><b>1</b><b>2</b></a>"}) {
+        assert(parallelChunks(xml, {.threads = 2, .split_path = {}, .min_chunk_bytes = 1}) == 0);
+    }
+    for (const std::string_view xml : {"<a>text<b>1</b><b>2</b></a>", "<a/>", "<a><b/><b>1</b></a>"}) {
+        assert(parallelChunks(xml, {.threads = 2, .split_path = {"b"}, .min_chunk_bytes = 1}) == 0);
+    }
+    assert(parallelChunks("<a><b><![CDATA[1]]></b><b>2</b></a>", {.threads = 2, .split_path = {}, .min_chunk_bytes = 1}) == 2);
+
+    // Errors are the same as those of a sequential parse, which is parsed again once a chunk fails
+    std::string malformed = records;
+    malformed.replace(malformed.find("<name>r&amp;1500"), 6, "<nam>");
+    std::size_t expected_offset = 0;
+    try {
+        (void)cpop::XMLParser::parse(malformed);
+        assert(false);
+    } catch (const cpop::ParseError& e) {
+        expected_offset = e.offset();
+    }
+    cpop::Stats malformed_stats;
+    try {
+        const cpop::StatsScope scope(malformed_stats);
+        (void)cpop::XMLParser::parseParallel(malformed, records_split);
+        assert(false);
+    } catch (const cpop::ParseError& e) {
+        assert(e.offset() == expected_offset);
+    }
+    assert(malformed_stats.parallel_chunks > 4);
+
+    struct Record {
+      cpop::Param<std::string> name{"name"};
+    };
+    struct Export {
+      cpop::Multiple<Record> records{"records", "record"};
+    };
+    Export populated;
+    cpop::Stats populate_stats;
+    {
+        const cpop::StatsScope scope(populate_stats);
+        cpop::populateFromTree(populated, cpop::XMLParser::parseParallel(records, records_split), "export");
+    }
+    assert(populate_stats.parallel_chunks > 4);
+    assert(populated.records.values.size() == 2000 && populated.records.values[1999].name.value == "r&1999");
+}
+
+
+void cpopSharedMemoryTest()
+{
+    std::println("\nShared memory test");
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+      cpop::OptParam<std::string> user{"user"};
+    };
+
+    struct Config {
+      cpop::Param<std::string> host{"host"};
+      cpop::Param<Database> primary{"primary"};
+      cpop::Multiple<Database> replicas{"replicas", "database"};
+      cpop::OptParam<int> missing{"missing"};
+    };
+
+    const std::string xml = R"(<config version="3">
+        <host>db.local</host>
+        <primary><name>main</name><port>5432</port><user>admin</user></primary>
+        <replicas>
+            <database><name>r1</name><port>5433</port></database>
+            <database><name>r2</name><port>5434</port></database>
+        </replicas>
+    </config>)";
+    const auto tree = cpop::XMLParser::parse(xml);
+
+    // A flat image populates and answers queries like the tree it was built from
+    const auto image = cpop::flattenTree(tree);
+    const cpop::FlatTree flat(image);
+    Config from_flat;
+    cpop::populateFromTree(from_flat, flat, "config");
+    assert(from_flat.host.value == "db.local");
+    assert(from_flat.primary.value.name.value == "main" && from_flat.primary.value.user.value == "admin");
+    assert(from_flat.replicas.values.size() == 2 && from_flat.replicas.values[1].port.value == 5434);
+    assert(!from_flat.missing.value.has_value());
+    assert(cpop::query<int>(flat, "config/replicas/database[1]/port") == 5434);
+    assert(cpop::query<std::string>(flat, "config/<xmlattr>/version") == "3");
+    assert(cpop::tryQuery<Database>(flat, "config/primary")->port.value == 5432);
+    assert(!cpop::tryQuery<int>(flat, "config/replicas/database[2]/port").has_value());
+    assert(!cpop::tryQuery<int>(flat, "config/replicas/database[").has_value());
+    assert(!cpop::tryQuery<Database>(flat, "config/replicas").has_value());
+
+    try {
+        (void)cpop::query<int>(flat, "config/host");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+#ifndef CPOP_NO_SOURCE_OFFSETS
+        assert((e.location(xml) == cpop::SourceLocation{.line = 2, .column = 9}));
+#endif
+    }
+
+    auto corrupt = image;
+    corrupt[sizeof(std::uint64_t) * 4] = std::byte{0xff}; // node count
+    try {
+        const cpop::FlatTree invalid(corrupt);
+        assert(false);
+    } catch (const cpop::ParseError&) {}
+
+    // Published into shared memory, a worker process attaches and populates in place
+    const std::string name = std::format("/cpop-test-{}", ::getpid());
+    cpop::ShmPublisher publisher(name);
+    assert(publisher.publish(tree) == 1);
+
+    const pid_t worker = ::fork();
+    if (worker == 0) {
+        const auto attached = cpop::ShmTree::attach(name);
+        Config config;
+        cpop::populateFromTree(config, attached.tree(), "config");
+        ::_exit(config.replicas.values.size() == 2 && config.primary.value.port.value == 5432 ? 0 : 1);
+    }
+    int status = 0;
+    ::waitpid(worker, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // A republished version is picked up by attaching again, the old one stays readable until then
+    auto attached = cpop::ShmTree::attach(name);
+    assert(attached.generation() == 1 && !attached.stale());
+
+    auto changed = cpop::XMLParser::parse(xml);
+    std::get<cpop::Node>(std::get<std::vector<cpop::Element>>(changed[0].content)[1].content).value = "db2.local";
+    assert(publisher.publish(changed) == 2);
+    assert(attached.stale());
+    assert(cpop::query<std::string>(attached.tree(), "config/host") == "db.local");
+
+    attached = cpop::ShmTree::attach(name);
+    assert(attached.generation() == 2 && !attached.stale());
+    assert(cpop::query<std::string>(attached.tree(), "config/host") == "db2.local");
+
+    // A version whose image does not match its generation, or is not a valid image, is reported by name
+    const auto overwriteVersion = [&name](std::span<const std::byte> bytes) {
+        const auto version = cpop::detail::ShmMapping::openWritable(name + ".2", bytes.size(), 0);
+        std::copy(bytes.begin(), bytes.end(), version.bytes().begin());
+    };
+    overwriteVersion(cpop::flattenTree(changed, 7));
+    try {
+        (void)cpop::ShmTree::attach(name);
+        assert(false);
+    } catch (const std::system_error& e) {
+        assert(e.code() == std::errc::bad_message);
+        assert(std::string_view(e.what()).find(name + ".2") != std::string_view::npos);
+    }
+
+    overwriteVersion(corrupt);
+    try {
+        (void)cpop::ShmTree::attach(name);
+        assert(false);
+    } catch (const std::system_error& e) {
+        assert(e.code() == std::errc::bad_message);
+        assert(std::string_view(e.what()).find(name + ".2") != std::string_view::npos);
+    }
+
+    try {
+        (void)cpop::ShmTree::attach("/cpop-test-never-published");
+        assert(false);
+    } catch (const std::system_error&) {}
+
+    // A control object that was created but not sized yet is waited for, one too small to be one is malformed
+    const std::string unsized = std::format("/cpop-test-unsized-{}", ::getpid());
+    for (const auto& [size, error] : {std::pair{0, std::errc::resource_unavailable_try_again}, std::pair{4, std::errc::bad_message}}) {
+        const int fd = ::shm_open(unsized.c_str(), O_RDWR | O_CREAT, 0644);
+        assert(fd >= 0);
+        const int truncated = ::ftruncate(fd, size);
+        assert(truncated == 0);
+        (void)truncated;
+        ::close(fd);
+        try {
+            (void)cpop::ShmTree::attach(unsized);
+            assert(false);
+        } catch (const std::system_error& e) {
+            assert(e.code() == error);
+            assert(std::string_view(e.what()).find(unsized) != std::string_view::npos);
+        }
+    }
+    ::shm_unlink(unsized.c_str());
+}
+
+void cpopMapTest()
+{
+    std::println("\nMap test");
+
+    struct Database {
+      cpop::Param<std::string> name{"name"};
+      cpop::Param<int> port{"port"};
+    };
+
+    struct Route {
+      cpop::Param<std::string> target{"target"};
+    };
+
+    struct Config {
+      cpop::Map<std::string, Database> databases{"db_list", "database", "name"};
+      cpop::Map<int, Route, std::map<int, Route>> routes{"routes", "route", "@id", cpop::DuplicateKeys::LastWins};
+    };
+
+    const std::string xml = R"(
+        <config>
+            <db_list>
+                <database><name>db1</name><port>5432</port></database>
+                <database><name>db2</name><port>5433</port></database>
+                <database><port>5434</port></database>
+            </db_list>
+            <routes>
+                <route id="2"><target>b</target></route>
+                <route id="1"><target>a</target></route>
+                <route id="two"><target>c</target></route>
+                <route id="2"><target>d</target></route>
+            </routes>
+        </config>
+    )";
+
+    cpop::Stats stats;
+    Config config;
+    {
+        cpop::StatsScope scope(stats);
+        cpop::populateFromTree(config, cpop::XMLParser::parse(xml), "config");
+    }
+    assert(config.databases.values.size() == 2);
+    assert(config.databases.values.at("db1").port.value == 5432);
+    assert(config.databases.values.at("db2").port.value == 5433);
+    assert(config.routes.values.size() == 2);
+    assert(config.routes.values.begin()->first == 1 && config.routes.values.at(1).target.value == "a");
+    assert(config.routes.values.at(2).target.value == "d");
+    if constexpr (cpop::Stats::enabled) {
+        assert(stats.warnings == 2); // the database without a name and the route with a key that is not a number
+    }
+
+    // Populating again replaces the map, from a FlatTree as from a Tree
+    const auto image = cpop::flattenTree(cpop::XMLParser::parse(
+        "<config><db_list><database><name>db3</name><port>1</port></database></db_list>"
+        "<routes><route id=\"7\"><target>e</target></route></routes></config>"));
+    cpop::populateFromTree(config, cpop::FlatTree(image), "config");
+    assert(config.databases.values.size() == 1 && config.databases.values.at("db3").port.value == 1);
+    assert(config.routes.values.size() == 1 && config.routes.values.at(7).target.value == "e");
+
+    const std::string duplicates = R"(
+        <config><db_list>
+            <database><name>db1</name><port>1</port></database>
+            <database><name>db1</name><port>2</port></database>
+        </db_list></config>
+    )";
+
+    struct FirstWins {
+      cpop::Map<std::string, Database> databases{"db_list", "database", "name", cpop::DuplicateKeys::FirstWins};
+    };
+
+    FirstWins first_wins;
+    cpop::populateFromTree(first_wins, cpop::XMLParser::parse(duplicates), "config");
+    assert(first_wins.databases.values.size() == 1 && first_wins.databases.values.at("db1").port.value == 1);
+
+    try {
+        cpop::populateFromTree(config, cpop::XMLParser::parse(duplicates), "config");
+        assert(false);
+    } catch (const cpop::PopulateError& e) {
+        assert(std::string_view(e.what()).find("Duplicate map key 'db1'") != std::string_view::npos);
+        assert((e.path() == std::vector<std::string>{"config", "db_list", "database"}));
+    }
+
+    // Map lists merge like Multiple lists
+    const auto rules = cpop::mergeRulesFor<Config>();
+    assert(rules.list_keys.contains("db_list") && rules.list_keys.contains("routes"));
+
+    // Reloading from a document without the optional keys and lists leaves nothing of the previous one
+    struct Reloaded {
+      cpop::OptParam<int> timeout{"timeout"};
+      cpop::Multiple<int> ports{"ports", "port"};
+      cpop::Map<std::string, Database> databases{"db_list", "database", "name"};
+    };
+    Reloaded reloaded;
+    cpop::populateFromTree(reloaded, cpop::XMLParser::parse(
+        "<config><timeout>5</timeout><ports><port>1</port></ports>"
+        "<db_list><database><name>db1</name><port>1</port></database></db_list></config>"), "config");
+    assert(reloaded.timeout.value == 5 && reloaded.ports.values.size() == 1 && reloaded.databases.values.size() == 1);
+    cpop::populateFromTree(reloaded, cpop::XMLParser::parse("<config><other>1</other></config>"), "config");
+    assert(!reloaded.timeout.value.has_value() && reloaded.ports.values.empty() && reloaded.databases.values.empty());
+}
+
 }
 
 int main() {
   cpopXmlParseTest();
   cpopTreeParseTest();
+  cpopPathQueryTest();
+  cpopSnapshotTest();
+  cpopStatsTest();
+  cpopSymbolTest();
+  cpopMovePopulateTest();
+  cpopConverterTest();
+  cpopComposeTest();
+  cpopStaticXmlTest();
+  cpopDeepDocumentTest();
+  cpopSharedTreeTest();
+  cpopPopulatePlanTest();
+  cpopFixedCapacityTest();
+  cpopSourceLocationTest();
+  cpopParallelParseTest();
+  cpopSharedMemoryTest();
+  cpopMapTest();
 
   std::println("\nAll tests completed successfully! ");
 